@@ -21,63 +21,231 @@
 DS2438::DS2438(OneWire *ow, uint8_t *address) {
     _ow = ow;
     _address = address;
+    _pageValid = false;
+    _present = false;
+    _transactions = 0;
+    _copies = 0;
 };
 
+/*
+ * Sets the channels to convert. The cached page 0 belongs to the device, not to the mode, so it is kept:
+ * the cache only saves bus traffic if the same DS2438 object lives across updates.
+ */
 void DS2438::begin(uint8_t mode) {
     _mode = mode & (DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE);
     _temperature = 0;
-    _voltageA = 0.0;
-    _voltageB = 0.0;
+    _voltageA = 0;
+    _voltageB = 0;
     _error = true;
     _timestamp = 0;
+    _state = DS2438_STATE_IDLE;
 }
 
 void DS2438::update() {
-    uint8_t data[9];
+    beginUpdate();
+    while (!poll())
+        ;
+}
 
+/*
+ * Starts an update without blocking. Call poll() until it returns true (or isReady() is true),
+ * the results are then available through getTemperature()/getVoltage()/isError().
+ */
+void DS2438::beginUpdate() {
     _error = true;
     _timestamp = millis();
+    resetCounters();
+
+    // the voltage conversion is needed for the temperature as well, so a temperature-only update runs on channel A
+    _pending = _mode & (DS2438_MODE_CHA | DS2438_MODE_CHB);
+    if (_mode == DS2438_MODE_TEMPERATURE)
+        _pending = DS2438_MODE_CHA;
+    if (!_pending) {
+        _error = false;
+        _state = DS2438_STATE_IDLE;
+        return;
+    }
+
+    // start with the channel that is already selected in the device, so at most one channel switch is needed
+    if (!(_pending & DS2438_MODE_CHA) || (_pending & DS2438_MODE_CHB && _pageValid && _page[0] & DS2438_CONFIG_AD))
+        _channel = DS2438_CHB;
+    else
+        _channel = DS2438_CHA;
+    _doTemperature = _mode & DS2438_MODE_TEMPERATURE;
+    _state = DS2438_STATE_SELECT;
+}
+
+/*
+ * Advances the update by at most one bus step and never waits for a conversion.
+ * Returns true once the update is finished.
+ */
+boolean DS2438::poll() {
+    uint8_t data[9];
+
+    switch (_state) {
+        case DS2438_STATE_SELECT:
+            if (!selectChannel(_channel)) {
+                _state = DS2438_STATE_IDLE;
+                return true;
+            }
+            selectDevice();
+            if (_doTemperature) {
+                _ow->write(DS2438_TEMPERATURE_CONVERSION_COMMAND, 0);
+                startWait(DS2438_TEMPERATURE_DELAY);
+                _state = DS2438_STATE_CONVERT_TEMPERATURE;
+            } else {
+                _ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
+                startWait(DS2438_VOLTAGE_CONVERSION_DELAY);
+                _state = DS2438_STATE_CONVERT_VOLTAGE;
+            }
+            return false;
 
-    if (_mode & DS2438_MODE_CHA || _mode == DS2438_MODE_TEMPERATURE) {
-        boolean doTemperature = _mode & DS2438_MODE_TEMPERATURE;
-        if (!startConversion(DS2438_CHA, doTemperature)) {
-            return;
-        }
-        if (!readPageZero(data))
-            return;
-        if (doTemperature) {
-            _temperature = (double)(((((int16_t)data[2]) << 8) | (data[1] & 0x0ff)) >> 3) * 0.03125;
-        }
-        if (_mode & DS2438_MODE_CHA) {
-            _voltageA = (((data[4] << 8) & 0x00300) | (data[3] & 0x0ff)) / 100.0;
-        }
+        case DS2438_STATE_CONVERT_TEMPERATURE:
+            if (!waitElapsed())
+                return false;
+            selectDevice();
+            _ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
+            startWait(DS2438_VOLTAGE_CONVERSION_DELAY);
+            _state = DS2438_STATE_CONVERT_VOLTAGE;
+            return false;
+
+        case DS2438_STATE_CONVERT_VOLTAGE:
+            if (!waitElapsed())
+                return false;
+            if (!readPageZero(data)) {
+                _state = DS2438_STATE_IDLE;
+                return true;
+            }
+            decodePageZero(data, _channel, _doTemperature);
+            _pending &= (_channel == DS2438_CHA) ? ~DS2438_MODE_CHA : ~DS2438_MODE_CHB;
+            if (_pending) {
+                // the temperature has already been converted along with the first channel
+                _channel = (_pending & DS2438_MODE_CHA) ? DS2438_CHA : DS2438_CHB;
+                _doTemperature = false;
+                _state = DS2438_STATE_SELECT;
+                return false;
+            }
+            _error = false;
+            _state = DS2438_STATE_IDLE;
+            return true;
+
+        default:
+            return true;
     }
-    if (_mode & DS2438_MODE_CHB) {
-        boolean doTemperature = _mode & DS2438_MODE_TEMPERATURE && !(_mode & DS2438_MODE_CHA);
-        if (!startConversion(DS2438_CHB, doTemperature)) {
-            return;
-        }
-        if (!readPageZero(data))
-            return;
-        if (doTemperature) {
-            _temperature = (double)(((((int16_t)data[2]) << 8) | (data[1] & 0x0ff)) >> 3) * 0.03125;
-        }
-        _voltageB = (((data[4] << 8) & 0x00300) | (data[3] & 0x0ff)) / 100.0;
+}
+
+boolean DS2438::isReady() {
+    return _state == DS2438_STATE_IDLE;
+}
+
+/*
+ * Batched acquisition: instead of converting each device with its own addressed commands, the caller selects the
+ * channel on every device with prepareChannel(), starts the conversion on all devices of the bus at once with
+ * broadcastTemperatureConversion()/broadcastVoltageConversion() (Skip ROM), waits a single conversion delay
+ * and then collects each device with readConversion().
+ */
+void DS2438::broadcastTemperatureConversion(OneWire *ow) {
+    ow->reset();
+    ow->skip();
+    ow->write(DS2438_TEMPERATURE_CONVERSION_COMMAND, 0);
+}
+
+void DS2438::broadcastVoltageConversion(OneWire *ow) {
+    ow->reset();
+    ow->skip();
+    ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
+}
+
+boolean DS2438::prepareChannel(int channel) {
+    return selectChannel(channel);
+}
+
+boolean DS2438::readConversion(int channel, boolean doTemperature) {
+    uint8_t data[9];
+
+    _timestamp = millis();
+    if (!readPageZero(data)) {
+        _error = true;
+        return false;
     }
+    decodePageZero(data, channel, doTemperature);
     _error = false;
+    return true;
+}
+
+/*
+ * Streaming: a voltage-only conversion addressed to this device on the channel set with prepareChannel().
+ * Poll isConversionDone() and fetch the result with readVoltage(), then start the next conversion right away.
+ * The configured mode is neither used nor changed, so the regular results stay untouched.
+ */
+void DS2438::startVoltageConversion() {
+    selectDevice();
+    _ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
+    startWait(DS2438_VOLTAGE_CONVERSION_DELAY);
+}
+
+boolean DS2438::isConversionDone() {
+    return waitElapsed();
+}
+
+/*
+ * Reads the busy flags of the status/configuration register: TB is set while a temperature conversion runs,
+ * ADB while a voltage conversion runs. Unlike a DS18B20, a DS2438 does not signal completion through read slots.
+ * Returns false if page 0 could not be read.
+ */
+boolean DS2438::readBusy(boolean &busy) {
+    uint8_t data[9];
+
+    if (!readPageZero(data))
+        return false;
+    busy = data[0] & (DS2438_CONFIG_TB | DS2438_CONFIG_ADB);
+    return true;
+}
+
+boolean DS2438::readVoltage(float &voltage) {
+    uint16_t raw;
+
+    if (!readVoltageRaw(raw))
+        return false;
+    voltage = raw / 100.0;
+    return true;
+}
+
+/*
+ * Same as readVoltage(), but the result stays an integer in units of 10 mV as delivered by the device.
+ */
+boolean DS2438::readVoltageRaw(uint16_t &voltage) {
+    uint8_t data[9];
+
+    if (!readPageZero(data))
+        return false;
+    _timestamp = millis();
+    voltage = decodeVoltage(data);
+    return true;
 }
 
 double DS2438::getTemperature() {
-    return _temperature;
+    return _temperature * 0.03125;
 }
 
 float DS2438::getVoltage(int channel) {
+    return getVoltageRaw(channel) / 100.0;
+}
+
+/*
+ * Raw results as delivered by the device, without floating point: temperature in 1/32 degree C, voltage in 10 mV.
+ */
+int16_t DS2438::getTemperatureRaw() {
+    return _temperature;
+}
+
+uint16_t DS2438::getVoltageRaw(int channel) {
     if (channel == DS2438_CHA) {
         return _voltageA;
     } else if (channel == DS2438_CHB) {
         return _voltageB;
     } else {
-        return 0.0;
+        return 0;
     }
 }
 
@@ -85,64 +253,128 @@ boolean DS2438::isError() {
     return _error;
 }
 
+/*
+ * Whether a device answered the reset of the last bus transaction. After a failed read this tells a missing
+ * device (false) from a disturbed transfer (true).
+ */
+boolean DS2438::isPresent() {
+    return _present;
+}
+
 unsigned long DS2438::getTimestamp() {
     return _timestamp;
 }
 
-boolean DS2438::startConversion(int channel, boolean doTemperature) {
-    if (!selectChannel(channel))
-        return false;
-    _ow->reset();
-    _ow->select(_address);
+/*
+ * Number of bus transactions (reset/select sequences) issued by the last update.
+ */
+uint16_t DS2438::getTransactionCount() {
+    return _transactions;
+}
+
+/*
+ * Number of copy scratchpad commands (EEPROM writes of page 0) issued by the last update.
+ */
+uint16_t DS2438::getCopyCount() {
+    return _copies;
+}
+
+/*
+ * Clears the counters. beginUpdate() does this on its own, batched acquisition calls it once per cycle.
+ */
+void DS2438::resetCounters() {
+    _transactions = 0;
+    _copies = 0;
+}
+
+void DS2438::decodePageZero(uint8_t *data, int channel, boolean doTemperature) {
     if (doTemperature) {
-        _ow->write(DS2438_TEMPERATURE_CONVERSION_COMMAND, 0);
-        delay(DS2438_TEMPERATURE_DELAY);
-        _ow->reset();
-        _ow->select(_address);
+        _temperature = (int16_t)((((int16_t)data[2]) << 8) | (data[1] & 0x0ff)) >> 3;
     }
-    _ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
-    delay(DS2438_VOLTAGE_CONVERSION_DELAY);
-    return true;
+    if (channel == DS2438_CHA) {
+        if (_mode & DS2438_MODE_CHA)
+            _voltageA = decodeVoltage(data);
+    } else {
+        if (_mode & DS2438_MODE_CHB)
+            _voltageB = decodeVoltage(data);
+    }
+}
+
+uint16_t DS2438::decodeVoltage(uint8_t *data) {
+    return ((data[4] << 8) & 0x00300) | (data[3] & 0x0ff);
+}
+
+void DS2438::startWait(unsigned long ms) {
+    _waitStart = micros();
+    _waitTime = ms * 1000;
 }
 
+boolean DS2438::waitElapsed() {
+    return micros() - _waitStart >= _waitTime;
+}
+
+/*
+ * Selects the A/D input through the AD bit of the status/configuration register. The last page 0
+ * read from the device is kept, so the read-modify-write only happens when the channel actually changes.
+ */
 boolean DS2438::selectChannel(int channel) {
+    uint8_t config;
     uint8_t data[9];
-    if (readPageZero(data)) {
-        if (channel == DS2438_CHB)
-            data[0] = data[0] | 0x08;
-        else
-            data[0] = data[0] & 0xf7;
-        writePageZero(data);
+    // readPageZero() needs room for the CRC byte and keeps the first 8 bytes in _page itself
+    if (!_pageValid && !readPageZero(data))
+        return false;
+    if (channel == DS2438_CHB)
+        config = _page[0] | DS2438_CONFIG_AD;
+    else
+        config = _page[0] & ~DS2438_CONFIG_AD;
+    if (config == _page[0])
         return true;
-    }
-    return false;
+    _page[0] = config;
+    writePageZero(_page);
+    return true;
 }
 
+/*
+ * The AD bit is only applied by the copy scratchpad command, which also commits page 0 to EEPROM.
+ * It is therefore only called by selectChannel() when the configuration changes.
+ */
 void DS2438::writePageZero(uint8_t *data) {
-    _ow->reset();
-    _ow->select(_address);
+    selectDevice();
     _ow->write(DS2438_WRITE_SCRATCHPAD_COMMAND, 0);
     _ow->write(DS2438_PAGE_0, 0);
     for (int i = 0; i < 8; i++)
         _ow->write(data[i], 0);
-    _ow->reset();
-    _ow->select(_address);
+    selectDevice();
     _ow->write(DS2438_COPY_SCRATCHPAD_COMMAND, 0);
     _ow->write(DS2438_PAGE_0, 0);
+    _copies++;
 }
 
 boolean DS2438::readPageZero(uint8_t *data) {
-    _ow->reset();
-    _ow->select(_address);
+    if (!selectDevice()) {
+        _pageValid = false;
+        return false;
+    }
     _ow->write(DS2438_RECALL_MEMORY_COMMAND, 0);
     _ow->write(DS2438_PAGE_0, 0);
-    _ow->reset();
-    _ow->select(_address);
+    selectDevice();
     _ow->write(DS2438_READ_SCRATCHPAD_COMMAND, 0);
     _ow->write(DS2438_PAGE_0, 0);
     for (int i = 0; i < 9; i++)
         data[i] = _ow->read();
-    return _ow->crc8(data, 8) == data[8];
+    if (_ow->crc8(data, 8) != data[8]) {
+        _pageValid = false;
+        return false;
+    }
+    for (int i = 0; i < 8; i++)
+        _page[i] = data[i];
+    _pageValid = true;
+    return true;
 }
 
-
+boolean DS2438::selectDevice() {
+    _present = _ow->reset();
+    _ow->select(_address);
+    _transactions++;
+    return _present;
+}
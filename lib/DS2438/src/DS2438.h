@@ -30,6 +30,10 @@
 #define DS2438_RECALL_MEMORY_COMMAND 0xb8
 #define DS2438_PAGE_0 0x00
 
+#define DS2438_CONFIG_AD 0x08
+#define DS2438_CONFIG_TB 0x10
+#define DS2438_CONFIG_ADB 0x40
+
 #define DS2438_CHA 0
 #define DS2438_CHB 1
 
@@ -40,25 +44,63 @@
 #define DS2438_TEMPERATURE_DELAY 10
 #define DS2438_VOLTAGE_CONVERSION_DELAY 8
 
+#define DS2438_STATE_IDLE 0
+#define DS2438_STATE_SELECT 1
+#define DS2438_STATE_CONVERT_TEMPERATURE 2
+#define DS2438_STATE_CONVERT_VOLTAGE 3
+
 class DS2438 {
     public:
-        DS2438(OneWire *ow, uint8_t *address);
+        DS2438(OneWire *ow = nullptr, uint8_t *address = nullptr);
         void begin(uint8_t mode=(DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE));
         void update();
+        void beginUpdate();
+        boolean poll();
+        boolean isReady();
+        static void broadcastTemperatureConversion(OneWire *ow);
+        static void broadcastVoltageConversion(OneWire *ow);
+        boolean prepareChannel(int channel);
+        boolean readConversion(int channel, boolean doTemperature);
+        void startVoltageConversion();
+        boolean isConversionDone();
+        boolean readBusy(boolean &busy);
+        boolean readVoltage(float &voltage);
+        boolean readVoltageRaw(uint16_t &voltage);
         double getTemperature();
         float getVoltage(int channel=DS2438_CHA);
+        int16_t getTemperatureRaw();
+        uint16_t getVoltageRaw(int channel=DS2438_CHA);
         boolean isError();
+        boolean isPresent();
         unsigned long getTimestamp();
+        uint16_t getTransactionCount();
+        uint16_t getCopyCount();
+        void resetCounters();
     private:
         OneWire *_ow;
         uint8_t *_address;
         uint8_t _mode;
-        double _temperature;
-        float _voltageA;
-        float _voltageB;
+        int16_t _temperature;
+        uint16_t _voltageA;
+        uint16_t _voltageB;
         unsigned long _timestamp;
         boolean _error;
-        boolean startConversion(int channel, boolean doTemperature);
+        uint8_t _state;
+        int _channel;
+        uint8_t _pending;
+        uint8_t _page[8];
+        boolean _pageValid;
+        boolean _present;
+        uint16_t _transactions;
+        uint16_t _copies;
+        boolean _doTemperature;
+        unsigned long _waitStart;
+        unsigned long _waitTime;
+        boolean selectDevice();
+        void decodePageZero(uint8_t *data, int channel, boolean doTemperature);
+        uint16_t decodeVoltage(uint8_t *data);
+        void startWait(unsigned long ms);
+        boolean waitElapsed();
         boolean selectChannel(int channel);
         void writePageZero(uint8_t *data);
         boolean readPageZero(uint8_t *data);
@@ -2,18 +2,31 @@
 
 loadConfig()
 1. Config wird aus Flash geladen 
-   => Config liegt in config.sensorConfig vor
+   => Config liegt in config vor, die Sensor-Einträge als kompakte Records in config.sensorRecords
+
+loadTopology()
+   Die zuletzt bekannte Geräte-Liste wird aus dem Flash geladen
+   => Liegt in topology vor
+
+loadCalibrations()
+   Die Kalibrier-Tabellen werden aus dem Flash geladen und beim Hinzufügen eines Sensors in seinen Formatierer übersetzt
+   => Liegen in calibrations vor
 
 setup1Wire()
-2. Alle Sensoren werden per oneWire.search() ermittelt  
-   => Sensoren liegen in dallasSensors vor
+2. Auf jedem Bus in buses[] werden alle Sensoren per oneWire.search() ermittelt  
+   => Sensoren liegen im dallasSensors des jeweiligen Busses vor
+   Warmstart: Kennt topology Geräte des Busses, werden diese ohne Suche übernommen (weiter mit 4.), die Suche 
+   läuft zur Bestätigung per updateDiscovery() im Hintergrund
 3. Es wird durch alle Sensoren in dallasSensors iteriert und die Config-Werte ermittelt
 4. Zusammen mit den Config-Werten wird nun per addSensor() ein Eintrag in sensors.sensorList erzeugt
    => Nun liegen alle Sensoren in sensors.sensorList vor
 
 loop()
 5. Per updateTemperatures() und updateLevels() werden anhand der Sensor-Adressen in sensors.sensorList die aktuellen Werte aus dallasSensors bzw. aus DS2438 ermittelt und in sensors.sensorList geschrieben
-6. Per sensorValueToDisplay() wird nun der Wert mit Hilfe der Config im Sensor in einen C-String konvertiert
+   => Werte bleiben Ganzzahlen in der Einheit des Sensors (raw, 1/16 °C bzw. 10 mV), float wird nicht verwendet
+6. publishSnapshot() überträgt geänderte Sensoren in eine Momentaufnahme, erst dort wird per sensorValueToDisplay() 
+   der Wert mit dem beim Hinzufügen übersetzten Formatierer umgerechnet und in einen C-String konvertiert
+   => Anzeige, Webserver und MQTT lesen nur noch die Momentaufnahme und tun nichts, solange deren Version gleich bleibt
 
 */
 
@@ -31,12 +44,20 @@ loop()
 #include "sensors.h"
 
 // #define DRYRUN // Erzeugt Dummy-Sensoren, wenn keine echten angeschlossen sind
+// #define PROFILER // Erfasst Dauer und Fehler jeder Bus-Operation, Ausgabe per /profile und seriell
+#include "profiler.h"
+#include "virtualsensors.h"
 
 // *************** Konfig-Grundeinstellungen
-const int sensorConfigCount = 10;  // Gibt fan, wie viele Sensoren konfiguriert und gespeichert werden können
+const int sensorRecordBytes = 694;  // Platz für die kompakten Sensor-Einträge, siehe encodeSensorRecord(). Sensoren mit Standardwerten belegen keinen, es reicht für ca. 35 mit Namen und Format
+const int sensorRecordCount = sensorRecordBytes / 10;  // Höchstzahl der Einträge, ein gespeicherter Eintrag hat mindestens 10 Bytes
+const int sensorFormatBytes = 64;   // Platz für die gemeinsamen Format-Strings
+const int legacySensorConfigCount = 10;  // Anzahl der festen Einträge in der früheren Konfig (LegacyConfig)
 
+// Jede Änderung am Aufbau der Konfig braucht einen neuen head, sonst wird ein gespeicherter Stand mit falschem 
+// Versatz gelesen. Der bisherige Aufbau wird dann in loadLegacyConfig() übernommen, damit WLAN und MQTT erhalten bleiben.
 typedef struct {
-  char    head           [5] = "MRAb";
+  char    head           [5] = "MRAc";
   // WLAN
   boolean wifiEnabled        = true;
   char    wifiMode           = 'a'; // a = Access Point / c = Client
@@ -52,12 +73,62 @@ typedef struct {
   char    mqttUser      [21] = "ArudinoNano";
   char    mqttPassword  [21] = "DEIN_MQTT_PASSWORT";
   
-  // Sensor-Konfiguration
-  PersistantSensorConfig sensorConfig[sensorConfigCount];  
+  // Sensor-Konfiguration, zusammen so groß wie die früheren 10 festen Einträge
+  uint16_t sensorRecordLength = 0;                      // Belegte Bytes in sensorRecords
+  uint8_t  sensorRecords [sensorRecordBytes];           // Kompakte Einträge, direkt hintereinander
+  char     sensorFormats [sensorFormatBytes] = "";      // Format-Strings, jeweils mit '\0' abgeschlossen, ein leerer String beendet die Liste
 
   char    foot           [5] = "MRAe";
 } Config;
 
+// Frühere Konfig mit 10 festen Sensor-Einträgen, wird beim ersten Laden in die kompakte Form übernommen. Beide 
+// früheren Stände tragen den head "MRAb" und unterscheiden sich nur in der Größe der Sensor-Einträge, der foot liegt 
+// daher jeweils an anderer Stelle.
+typedef struct {
+  char    head           [5];
+  boolean wifiEnabled;
+  char    wifiMode;
+  int     wifiTimeout;
+  char    wifiSsid      [21];
+  char    wifiPass      [21];
+  boolean mqttEnabled;
+  char    mqttServer    [21];
+  int     mqttPort;
+  char    mqttName      [21];
+  char    mqttUser      [21];
+  char    mqttPassword  [21];
+} LegacyConfigHead;
+
+// Ursprünglicher Sensor-Eintrag mit 52 Bytes, Byte für Byte wie SensorConfig vor channels, resolution und alarm*
+struct BaselineSensorConfig {
+  SensorName            name;
+  SensorValueFormat     format;
+  SensorValueFormatMin  formatMin;
+  SensorValueFormatMax  formatMax;
+  SensorValuePrecision  precision;
+  SensorValueMin        min;
+  SensorValueMax        max;
+};
+
+struct BaselinePersistantSensorConfig {
+  SensorAddress         address;
+  BaselineSensorConfig  config;
+};
+
+// Ursprünglicher Stand, so wie er auf den Geräten im Einsatz gespeichert ist
+typedef struct {
+  LegacyConfigHead               connection;
+  BaselinePersistantSensorConfig sensorConfig[legacySensorConfigCount];
+  char                           foot      [5];
+} BaselineConfig;
+
+// Zwischenstand mit channels, resolution und alarm* im Sensor-Eintrag, siehe sanitizeLegacySensorConfig()
+typedef struct {
+  LegacyConfigHead        connection;
+  PersistantSensorConfig  sensorConfig[legacySensorConfigCount];
+  char                    foot      [5];
+} LegacyConfig;
+
 // WLAN-Port
 const int wifiPort = 80; // Port, auf den der HTTP-Server lauscht
 
@@ -85,22 +156,45 @@ boolean   initalClear = false;
 
 
 // 1-Wire
-const int PinOneWireBus = 10; // Pin, an dem der 1-Wire-Bus angeschlossen ist // = D10
+// Der erste Bus hängt an D10, der zweite an D9, jeder braucht seinen eigenen Pull-Up. Anzahl und Pins sind anpassbar 
+// z.B. per build_flags = -D ONEWIRE_BUS_COUNT=1 -D ONEWIRE_BUS_PINS={10} in der platformio.ini. Eine andere Anzahl 
+// verwirft beim nächsten Start den Geräte-Cache im Flash, siehe Topology.
+#ifndef ONEWIRE_BUS_COUNT
+#define ONEWIRE_BUS_COUNT 2
+#endif
+#ifndef ONEWIRE_BUS_PINS
+#define ONEWIRE_BUS_PINS {10, 9}
+#endif
+const int oneWireBusCount = ONEWIRE_BUS_COUNT;                      // Anzahl der 1-Wire-Busse
+const int PinOneWireBus[oneWireBusCount] = ONEWIRE_BUS_PINS;        // Pins, an denen die 1-Wire-Busse angeschlossen sind
 
 // Intervalle
 const int wifiCheckInterval   = 10;  // Frequenz in Sekunden, in der die WLAN-Verbindung versucht wird
-const int tempCheckInterval   = 5;   // Frequenz in Sekunden, in der die Temperaturen abgefragt werden
-const int levelCheckInterval  = 2;   // Frequenz in Sekunden, in der die Füllstände abgefragt werden
+const int tempCheckInterval   = 5;   // Frequenz in Sekunden, in der die Temperaturen anfangs abgefragt werden
+const int tempIntervalMin     = 2;   // Kürzestes Intervall in Sekunden für einen Temperatursensor, dessen Wert sich ändert
+const int tempIntervalMax     = 60;  // Längstes Intervall in Sekunden für einen Temperatursensor, dessen Wert stabil ist
+const SensorRaw tempChangeThreshold = 3; // Änderung in 1/16 °C (ca. 0,2 °C), ab der ein Temperatursensor als veränderlich gilt
+const int levelCheckInterval  = 2;   // Frequenz in Sekunden, in der die Füllstände anfangs abgefragt werden
+const int levelIntervalMin    = 1;   // Kürzestes Intervall in Sekunden für eine Tanksonde, deren Wert sich ändert
+const int levelIntervalMax    = 30;  // Längstes Intervall in Sekunden für eine Tanksonde, deren Wert stabil ist
+const SensorRaw levelChangeThreshold = 3; // Änderung in 10 mV, ab der eine Tanksonde als veränderlich gilt
 const int sendInterval        = 10;  // Frequenz in Sekunden, in der die Temperaturen an MQTT gesendet werden
 const int displayInterval     = 10;  // Frequenz in Sekunden, in der die Temperaturen angezeigt werden
 const int blinkInterval       = 500; // Frequenz in Millisekunden, in der die orange LED bei Fehlern blinkt
+const int discoveryInterval   = 30;  // Frequenz in Sekunden, in der der Bus nach neuen oder entfernten Sensoren durchsucht wird
+const int discoveryMissLimit  = 2;   // Anzahl der Suchläufe in Folge, die ein Sensor fehlen muss, bevor er entfernt wird
+const int topologySaveDelay   = 90;  // Zeit in Sekunden, die eine geänderte Geräteliste unverändert bestehen muss, bevor sie in den Cache kommt
+const int topologySaveInterval = 3600; // Mindestabstand in Sekunden zwischen zwei Schreibvorgängen des Caches im Betrieb
+const int sensorReadRetries   = 1;   // Anzahl der sofortigen Wiederholungen einer fehlgeschlagenen Abfrage im selben Zyklus
+const int sensorBackoffMax    = 120; // Längstes Intervall in Sekunden, auf das ein fehlerhafter Sensor zurückgestellt wird
+const int sensorQuarantineLimit = 6; // Anzahl der Fehlschläge in Folge, ab der ein Sensor in Quarantäne kommt
+const int sensorQuarantineInterval = 300; // Frequenz in Sekunden, in der ein Sensor in Quarantäne geprüft wird
+const int tempMatchConvertLimit = 2; // Anzahl fälliger DS18B20, bis zu der gezielt statt per Skip ROM an alle gewandelt wird
 
 
 // ***************  Globale Variablen
 
 // Allgemein
-unsigned long tempCheckLast   = 0;
-unsigned long levelCheckLast  = 0;
 unsigned long sendLast        = 0;
 unsigned long displayLast     = 0;
 unsigned long wifiCheckLast   = 0;
@@ -110,10 +204,150 @@ boolean       buttonState     = false;
 boolean       dummySensors    = false;
 
 // 1-Wire
-OneWire           oneWire(PinOneWireBus);     // 1-Wire Grundobjekt
-DallasTemperature dallasSensors(&oneWire);    // 1-Wire Objekt für Temperatursensoren
 Sensors           sensors;                    // Sensorliste
 
+// Zustände der nicht-blockierenden Temperatur-Abfrage
+typedef enum {
+  TEMP_IDLE,        // Keine Wandlung aktiv, es wird gewartet, bis ein Sensor fällig ist
+  TEMP_CONVERTING,  // Wandlung wurde gestartet, Sensoren werden gelesen, sobald die Wandlungszeit ihrer Auflösung abgelaufen ist
+  TEMP_READING,     // Alle Wandlungen sind fertig, die restlichen Scratchpads werden Sensor für Sensor gelesen
+  TEMP_ALARM_SEARCH // Sensoren mit Alarm-Band werden per Alarm-Suche (0xEC) ermittelt, gelesen werden nur die gemeldeten
+} TempState;
+
+
+// Zustände der Bus-Erkennung im Hintergrund
+typedef enum {
+  DISCOVERY_IDLE,       // Kein Suchlauf aktiv, es wird auf discoveryInterval gewartet
+  DISCOVERY_SEARCHING   // Suchlauf aktiv, pro Aufruf wird ein Gerät per oneWire.search() ermittelt
+} DiscoveryState;
+
+
+// DS2438-Treiber, werden einmalig in setup1Wire() an die Sensoren gebunden und bleiben über alle Abfragen erhalten.
+// So bleiben der zuletzt eingestellte Kanal, Fehlerzustand und Zeitstempel zwischen den Abfragen bekannt.
+const int ds2438PoolSize = 10;                // Gibt an, wie viele DS2438 gleichzeitig abgefragt werden können
+
+struct Ds2438Slot {
+  DeviceAddress         deviceAddress;        // Eigene Kopie der Adresse, da sich sensors.sensorList beim Hinzufügen verschiebt
+  DS2438                driver;
+  boolean               used            = false;
+};
+
+Ds2438Slot        ds2438Pool[ds2438PoolSize];
+
+// Zustände der gebündelten Füllstands-Abfrage
+typedef enum {
+  LEVEL_IDLE,       // Keine Abfrage aktiv, es wird gewartet, bis ein DS2438 fällig ist
+  LEVEL_SELECT,     // Der Kanal des aktuellen Durchgangs wird DS2438 für DS2438 eingestellt
+  LEVEL_CONVERT_T,  // Temperatur-Wandlung wurde per Skip-ROM an alle DS2438 gesendet, es wird gewartet
+  LEVEL_CONVERT_V,  // Spannungs-Wandlung wurde per Skip-ROM an alle DS2438 gesendet, es wird gewartet
+  LEVEL_READING     // Die Wandlung ist fertig, die DS2438 werden einzeln gelesen
+} LevelState;
+
+// Ein 1-Wire-Bus mit eigenen Bibliotheks-Objekten, eigener Planung und eigenen Abfrage-Zuständen. loop() bedient 
+// die Busse reihum mit je einem Schritt, so überlappt z.B. die Wandlung auf einem Bus mit dem Lesen auf einem anderen.
+struct OneWireBus {
+  uint8_t           index             = 0;          // Index in buses[], wird im Sensor als bus abgelegt
+  OneWire           oneWire;                        // 1-Wire Grundobjekt, der Pin wird in setup1Wire() gesetzt
+  DallasTemperature dallasSensors;                  // 1-Wire Objekt für Temperatursensoren
+  SensorSchedule    tempSchedule;                   // Planung der Temperatursensoren
+  SensorSchedule    levelSchedule;                  // Planung der DS2438
+  boolean           parasite          = true;       // Wird der Bus parasitär versorgt? Bis zur Prüfung in setup1Wire() wird davon ausgegangen
+  unsigned long     activity          = 0;          // Zähler der Bus-Zugriffe, wird nur von busAccessStart() erhöht
+
+  // Temperatur-Abfrage
+  TempState         tempState         = TEMP_IDLE;
+  unsigned long     tempConvertStart  = 0;          // Zeitpunkt, zu dem die Wandlung gestartet wurde
+  int               tempReadIndex     = 0;          // Nächster zu lesender Eintrag in sensors.sensorList
+  int               tempReadResolution = 9;         // Auflösung der aktuell gelesenen Sensoren, gelesen wird aufsteigend
+  boolean           tempAlarmPhase    = false;      // Es werden die von der Alarm-Suche gemeldeten Sensoren gelesen
+  int               tempAlarmResolution = 0;        // Höchste Auflösung der Sensoren mit Alarm-Band, 0 = keine Alarm-Suche nötig
+  int               tempWaitResolution = 9;         // Höchste Auflösung aller wandelnden Sensoren, bestimmt bei parasitärer Versorgung die Wartezeit
+  unsigned long     tempPollMark      = 0;          // Stand von activity beim Start der Wandlung
+
+  // Füllstands-Abfrage
+  LevelState        levelState        = LEVEL_IDLE;
+  int               levelReadIndex    = 0;          // Aktuell bearbeiteter Eintrag in sensors.sensorList
+  int               levelPass         = 0;          // Aktueller Durchgang: 0 = erster Kanal, 1 = zweiter Kanal
+  unsigned int      levelCycle        = 0;          // Zähler der Abfragen, bestimmt die Reihenfolge der Kanäle
+  boolean           levelTemperature  = false;      // Wird in diesem Zyklus eine Temperatur benötigt?
+  boolean           levelTemperatureDone = false;   // Wurde die Temperatur in diesem Zyklus bereits gewandelt?
+  unsigned long     levelWaitStart    = 0;          // Beginn der aktuellen Wandlung in Mikrosekunden
+  unsigned long     levelWaitTime     = 0;          // Dauer der aktuellen Wandlung in Mikrosekunden
+  int               levelPollIndex    = 0;          // Nächster DS2438, dessen Busy-Flags abgefragt werden, siehe levelConversionComplete()
+
+  // Bus-Erkennung
+  DiscoveryState    discoveryState    = DISCOVERY_IDLE;
+  int               discoveryFound    = 0;          // Anzahl der im laufenden Suchlauf gefundenen Geräte
+  unsigned long     discoveryLast     = 0;
+};
+
+OneWireBus        buses[oneWireBusCount];
+
+// Zuletzt bekannte Geräte-Liste, wird neben der Konfig im Flash gehalten. Beim Start werden die Sensoren daraus 
+// ohne Suche übernommen und sofort abgefragt (Warmstart), die Suche bestätigt die Liste danach im Hintergrund.
+const int topologyCacheCount = sensorCapacity; // Gibt an, wie viele Geräte im Cache gespeichert werden können
+
+struct TopologyEntry {
+  DeviceAddress         address;              // ROM-Code des Geräts
+  uint8_t               bus;                  // Index in buses[]
+  char                  type;                 // Typ, siehe SensorType
+  SensorResolution      resolution;           // Nur DS18B20: Im Sensor eingestellte Auflösung
+  SensorAlarm           alarmLow;             // Nur DS18B20: Im Sensor eingestelltes TL
+  SensorAlarm           alarmHigh;            // Nur DS18B20: Im Sensor eingestelltes TH
+};
+
+typedef struct {
+  char          head      [5] = "MRAt";
+  uint8_t       count         = 0;
+  boolean       parasite  [oneWireBusCount] = {};   // Versorgung je Bus, da begin() beim Warmstart entfällt
+  TopologyEntry entries   [topologyCacheCount];
+  char          foot      [5] = "MRAu";
+} Topology;
+
+// Kalibrier-Tabellen, werden mit der Konfig gespeichert, aber in einem eigenen Bereich des Flash, damit das Layout 
+// der Konfig gleich bleibt. Nur wenige Sensoren (Tanksonden) brauchen eine, daher gibt es nur calibrationCount Plätze.
+const int calibrationCount = 4; // Gibt an, wie viele Sensoren eine Kalibrier-Tabelle haben können
+
+typedef struct {
+  char              head      [5] = "MRAk";
+  uint8_t           count         = 0;
+  SensorCalibration entries   [calibrationCount];
+  char              foot      [5] = "MRAl";
+} Calibrations;
+
+// Ausdrücke der abgeleiteten Sensoren, siehe virtualsensors.h. Der Sensor mit Index i hat die Adresse 00 i+1 00 ... 00,
+// Name, Format usw. erhält er wie jeder andere Sensor über die Konfig. Ein leerer Ausdruck lässt den Platz frei.
+const int virtualSensorCount    = 4;  // Gibt an, wie viele abgeleitete Sensoren es geben kann
+const int virtualExpressionSize = 64; // Länge eines Ausdrucks
+
+typedef struct {
+  char              head      [5] = "MRAv";
+  char              expressions [virtualSensorCount][virtualExpressionSize] = {};
+  char              foot      [5] = "MRAw";
+} VirtualSensors;
+
+// Zustände des Diagnose-Streamings eines einzelnen DS2438
+typedef enum {
+  STREAM_OFF,       // Kein Streaming aktiv
+  STREAM_SELECT,    // Der Kanal wird eingestellt und die erste Wandlung gestartet
+  STREAM_CONVERTING // Spannungs-Wandlung läuft, danach wird gelesen und sofort die nächste gestartet
+} StreamState;
+
+StreamState   streamState       = STREAM_OFF;
+int           streamSensor      = -1;         // Gestreamter Eintrag in sensors.sensorList
+int           streamChannel     = DS2438_CHA; // Gestreamter Kanal
+unsigned long streamSamples     = 0;          // Anzahl der bisher gestreamten Messwerte
+WiFiClient    streamClient;                   // HTTP-Client, an den die Messwerte zusätzlich gehen
+
+// Momentaufnahme für Anzeige, HTTP und MQTT, siehe publishSnapshot()
+SensorSnapshot  snapshots[2];                 // Vorderer und hinterer Puffer
+volatile uint8_t snapshotFront  = 0;          // Index des vorderen Puffers in snapshots
+boolean         snapshotStale   = true;       // Ein Formatierer wurde neu übersetzt, alle Werte neu formatieren
+uint32_t        displayVersion  = 0;          // Zuletzt angezeigte Version
+uint32_t        mqttVersion     = 0;          // Zuletzt an MQTT übermittelte Version
+uint32_t        htmlVersion     = 0;          // Version, zu der htmlValues erzeugt wurde
+String          htmlValues      = "";         // Ergebnis von getValuesAsHtml()
+
 // Webserver
 IPAddress   ip; 
 WiFiServer  server(wifiPort);
@@ -130,6 +364,20 @@ TFT_ILI9163C tft = TFT_ILI9163C(TFT_CS, TFT_DC, TFT_RST);
 // Speicher
 FlashStorage(configStorage, Config);
 Config config;
+uint16_t configRecordOffsets[sensorRecordCount]; // Beginn jedes Eintrags in config.sensorRecords, per indexSensorRecords()
+int      configRecordCount = 0;                 // Anzahl der Einträge in configRecordOffsets
+FlashStorage(topologyStorage, Topology);
+Topology topology;
+boolean       topologyPending = false;     // Geräteliste weicht vom Cache ab, wartet auf topologySaveDelay
+uint32_t      topologyPendingSignature;    // Prüfsumme der abweichenden Geräteliste, jede weitere Änderung startet neu
+unsigned long topologyPendingSince;
+unsigned long topologySavedAt = 0;         // Letzter Schreibvorgang des Caches für topologySaveInterval
+FlashStorage(calibrationStorage, Calibrations);
+Calibrations        calibrations;
+CompiledCalibration calibrationPool[calibrationCount];  // Übersetzte Form von calibrations.entries, gleicher Index
+FlashStorage(virtualStorage, VirtualSensors);
+VirtualSensors      virtualSensors;
+VirtualProgram      virtualPool[virtualSensorCount];    // Übersetzte Form von virtualSensors.expressions, gleicher Index
 
 // *************** Deklaration der Funktionen
 
@@ -144,24 +392,85 @@ boolean connectToMQTT();
 
 // Config-Funktionen
 boolean loadConfig();
+boolean loadLegacyConfig();
+void copyLegacyConfigHead(const LegacyConfigHead &legacy);
+void addLegacySensorRecord(const DeviceAddress deviceAddress, const SensorConfig &sensorConfig);
+void sanitizeLegacySensorConfig(SensorConfig &sensorConfig);
 void saveConfig();
 void printConfig(Config &pconfig);
 void copyConfig(const Config &from, Config &to);
+void indexSensorRecords();
+boolean addSensorRecord(Config &target, const DeviceAddress deviceAddress, const SensorConfig &sensorConfig);
+boolean getSensorRecord(const Config &source, const int offset, DeviceAddress deviceAddress, SensorConfig &output, int &length);
+boolean loadTopology();
+void saveTopology(const boolean immediate = false);
+boolean loadCalibrations();
+void saveCalibrations();
+int findCalibration(const DeviceAddress deviceAddress);
+void applyCalibration(const int index);
 
 // Sensorlisten-Funktionen
-void addSensor(const SensorAddress address, const SensorName name, const SensorType type, const SensorValueFormat format, const SensorValueFormatMin formatMin, const SensorValueFormatMax formatMax, const SensorValuePrecision precision, const SensorValueMin min, const SensorValueMax max, float value);
-void addSensor(Sensor sensor);
-void removeSensor(SensorAddress address);
-boolean updateSensorValue(const SensorAddress address, const float value);
+int addSensor(const SensorAddress address, const SensorName name, const SensorType type, const SensorValueFormat format, const SensorValueFormatMin formatMin, const SensorValueFormatMax formatMax, const SensorValuePrecision precision, const SensorValueMin min, const SensorValueMax max, float value);
+int addSensor(const Sensor &sensor);
+void removeSensor(const SensorRom rom);
+boolean updateSensorValue(const SensorRom rom, const SensorRaw raw);
 void clearSensorList();
-boolean getSensorType(const SensorAddress address, SensorType& type);
-boolean getSensorConfig(const SensorAddress address, SensorConfig &output);
+void indexSensor(const int index);
+void unindexSensor(const int index);
+int findSensorByRom(const SensorRom rom);
+int findSensor(const DeviceAddress deviceAddress);
+boolean writeTemperatureRegisters(OneWireBus &bus, const DeviceAddress deviceAddress, const SensorResolution resolution, const SensorAlarm alarmLow, const SensorAlarm alarmHigh);
+int registerSensor(OneWireBus &bus, const DeviceAddress deviceAddress, const TopologyEntry *cached = nullptr);
+int bindDs2438(Sensor &sensor);
+void releaseDs2438(Sensor &sensor);
+boolean getSensorType(const SensorRom rom, SensorType& type);
+boolean getSensorConfig(const DeviceAddress deviceAddress, SensorConfig &output);
+
+// Scheduler-Funktionen
+boolean isSensorDue(const Sensor &sensor, const unsigned long now);
+void scheduleSensor(SensorSchedule &schedule, const int index);
+int popDueSensors(SensorSchedule &schedule, const unsigned long now);
+void rescheduleDueSensors(OneWireBus &bus, const char type);
+void initSensorSchedule(const int index);
+void rebuildSchedule();
+void setupSchedule();
 
 // Ein- & Ausgabe-Funktionen
-void updateTemperatures();
-void updateLevels();
+unsigned long busAccessStart(OneWireBus &bus);
+boolean busConversionComplete(OneWireBus &bus, const unsigned long mark);
+boolean levelConversionComplete(OneWireBus &bus);
+void updateTemperatures(OneWireBus &bus);
+int getConversionResolution(const Sensor &sensor);
+boolean nextTemperatureSensor(OneWireBus &bus);
+boolean isTemperatureSensorInPhase(const OneWireBus &bus, const Sensor &sensor);
+void finishTemperatureReads(OneWireBus &bus);
+SensorStatus readTemperatureScratchPad(OneWireBus &bus, const DeviceAddress deviceAddress, int16_t &raw);
+void readTemperatureSensor(Sensor &sensor);
+void updateLevels(OneWireBus &bus);
+void startDiscovery(OneWireBus &bus);
+void updateDiscovery(OneWireBus &bus);
+boolean startStream(const int index, const int channel);
+void stopStream();
+boolean isStreaming(const Sensor &sensor);
+void updateStream();
+boolean loadVirtualSensors();
+void saveVirtualSensors();
+void virtualSensorAddress(const int index, DeviceAddress deviceAddress);
+boolean resolveSensorName(const char *name, DeviceAddress deviceAddress);
+void setupVirtualSensors();
+boolean readVirtualInput(const VirtualInput &input, SensorRaw &raw, SensorUnit &unit);
+void updateVirtualSensors();
+void publishSnapshot();
+const SensorSnapshot& currentSnapshot();
+int getLevelPassChannel(const OneWireBus &bus, const int pass);
+boolean isLevelProbeInPass(const OneWireBus &bus, const Sensor &sensor, const int pass);
+boolean nextLevelProbeInPass(OneWireBus &bus);
+void prepareLevelProbe(Sensor &sensor, const int channel);
+void readLevelProbe(Sensor &sensor, const int channel, const boolean doTemperature);
+boolean getLevelProbeValue(DS2438 &probe, const SensorChannels channels, const int channel, SensorRaw &raw);
+ProfileResult getProbeProfileResult(DS2438 &probe, const boolean success);
 void printSensors();
-void printSensorAddresses();
+void printSensorAddresses(OneWireBus &bus);
 void printWiFiStatus();
 void displayBackground(); 
 void displayValues(); 
@@ -171,17 +480,22 @@ void reset();
 
 // HTTP-Funktionen
 char* getValue(const String& data, const char* key);
+boolean copyValue(const String& data, const char* key, char* output, const int size);
 String getValuesAsHtml();
-char* urlDecode(const char* input);
+void urlDecode(char* text);
 int hexToDec(char c);
 void htmlGetHeader(int refresh);
 void htmlGetStatus();
 void htmlGetConfig();
+void htmlGetSensorConfigRow(const int row, const char *address, const SensorConfig &sensorConfig, const DeviceAddress deviceAddress);
 void htmlSetConfig();
+void htmlStartStream(const String &request);
+void htmlGetProfile();
 void httpProcessRequests();
 
 //  Setup-Funktionen
 void setup1Wire(); 
+int setupBusFromTopology(OneWireBus &bus);
 void setupDisplay();
 void setupMemory();
 void setupWifi();
@@ -199,37 +513,41 @@ char* fillBlank(const char* input, const u_int length) {
 }
 
 
-char* urlDecode(const char* input) {
-  // Decode URL-encoded data
-  String decoded = "";
-  char a, b;
-  for (size_t i = 0; i < strlen(input); i++) {
-    if (input[i] == '%') {
-      a = input[++i];
-      b = input[++i];
-      decoded += char((hexToDec(a) << 4) | hexToDec(b));
+void urlDecode(char* text) {
+  // Dekodiert URL-kodierte Daten an Ort und Stelle, das Ergebnis ist nie länger als die Eingabe. 
+  // Kein Puffer auf dem Heap, der bei jedem getValue() freigegeben werden müsste.
+  char* output = text;
+  for (const char* input = text; *input != '\0'; input++) {
+    if (*input == '%' && input[1] != '\0' && input[2] != '\0') {
+      *output++ = char((hexToDec(input[1]) << 4) | hexToDec(input[2]));
+      input += 2;
+    } else if (*input == '+') {
+      *output++ = ' ';
     } else {
-      if (input[i] == '+') {
-        decoded += ' ';
-      } else {
-        decoded += input[i];
-      }
+      *output++ = *input;
     }
   }
-
-  char* result = new char[decoded.length() + 1];
-  strcpy(result, decoded.c_str());
-  return result;
+  *output = '\0';
 }
 
 int hexToDec(char c) {
   return (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : 0;
 }
 
+boolean copyValue(const String& data, const char* key, char* output, const int size) {
+  // Kopiert den Wert gekürzt auf size Bytes samt '\0', false und output unverändert, wenn der Schlüssel fehlt
+  const char* value = getValue(data, key);
+
+  if (value == nullptr) {
+    return false;
+  }
+  snprintf(output, size, "%s", value);
+  return true;
+}
+
 char* getValue(const String& data, const char* key) {
-  static char result[100]; // Annahme: Der Wert passt in einen 100-Byte-Puffer
+  static char result[160]; // Annahme: Der Wert passt in einen 160-Byte-Puffer, z.B. eine Kalibrier-Tabelle
   String delimiter = "=";
-  char temp[100];
   int keyIndex = data.indexOf(key + delimiter);
   int endIndex;
 
@@ -253,8 +571,7 @@ char* getValue(const String& data, const char* key) {
   result[sizeof(result) - 1] = '\0';
   Serial.print("  result vor urldecode: ");
   Serial.println(result);
-  strcpy(temp, urlDecode(result));
-  strcpy(result, temp);
+  urlDecode(result);
   Serial.print("  result nach urldecode: ");
   Serial.println(result);
   Serial.println("getValue()");
@@ -279,20 +596,18 @@ void copyConfig(const Config &from, Config &to) {
   strcpy(to.mqttPassword,  from.mqttPassword);
   
   // Sensor-Konfig
-  for (int i = 0; i < sensorConfigCount; i++) {
-    strcpy(to.sensorConfig[i].address,    from.sensorConfig[i].address);  
-    strcpy(to.sensorConfig[i].config.name,       from.sensorConfig[i].config.name);  
-    strcpy(to.sensorConfig[i].config.format,     from.sensorConfig[i].config.format);  
-           to.sensorConfig[i].config.formatMin = from.sensorConfig[i].config.formatMin;
-           to.sensorConfig[i].config.formatMax = from.sensorConfig[i].config.formatMax;
-           to.sensorConfig[i].config.precision = from.sensorConfig[i].config.precision;
-           to.sensorConfig[i].config.min       = from.sensorConfig[i].config.min;
-           to.sensorConfig[i].config.max       = from.sensorConfig[i].config.max;
-  }
+  to.sensorRecordLength = min((int)from.sensorRecordLength, sensorRecordBytes);
+  memcpy(to.sensorRecords, from.sensorRecords, to.sensorRecordLength);
+  memcpy(to.sensorFormats, from.sensorFormats, sensorFormatBytes);
   Serial.println("copyConfig() end");
 };
 
 void printConfig(Config &pconfig) {
+  char          channels[4];
+  DeviceAddress deviceAddress;
+  SensorAddress address;
+  SensorConfig  sensorConfig;
+  int           length;
   Serial.println("printConfig() begin");
 
   Serial.print("  wifiEnabled: ");
@@ -328,35 +643,78 @@ void printConfig(Config &pconfig) {
   Serial.print("  mqttPassword: ");
   Serial.println(pconfig  .mqttPassword);
 
-  for (int i = 0; i < sensorConfigCount; i++) {
+  Serial.print("  sensorRecordLength: ");
+  Serial.println(pconfig.sensorRecordLength);
+  for (int i = 0, offset = 0; getSensorRecord(pconfig, offset, deviceAddress, sensorConfig, length); i++, offset += length) {
+    deviceAddressToHex(deviceAddress, address);
     Serial.print("  sensorConfig");  
     Serial.print(i);  
     Serial.print(": Address: ");  
-    Serial.print(pconfig.sensorConfig[i].address);  
+    Serial.print(address);  
+    Serial.print(" Länge: ");  
+    Serial.print(length);  
     Serial.print(" Name: ");  
-    Serial.print(pconfig.sensorConfig[i].config.name);  
+    Serial.print(sensorConfig.name);  
     Serial.print(" Format: ");  
-    Serial.print(pconfig.sensorConfig[i].config.format);  
+    Serial.print(sensorConfig.format);  
     Serial.print(" Precision: ");  
-    Serial.print(pconfig.sensorConfig[i].config.precision);  
+    Serial.print(sensorConfig.precision);  
     Serial.print(" Min: ");  
-    Serial.print(pconfig.sensorConfig[i].config.min);  
+    Serial.print(sensorConfig.min);  
     Serial.print(" Max: ");  
-    Serial.println(pconfig.sensorConfig[i].config.max);  
+    Serial.print(sensorConfig.max);  
+    Serial.print(" Kanäle: ");  
+    channelsToStr(sensorConfig.channels, channels);
+    Serial.print(channels);  
+    Serial.print(" Auflösung: ");  
+    Serial.print(sensorConfig.resolution);  
+    Serial.print(" Alarm: ");  
+    Serial.print(sensorConfig.alarmLow);  
+    Serial.print(" bis ");  
+    Serial.println(sensorConfig.alarmHigh);  
   }
 
   Serial.println("printConfig() end");
 }
 
 void clearSensorList() {
-  // Befreie den Speicher von sensorList
-  free(sensors.sensorList);
+  // Gib die Treiber der DS2438 frei und alle Plätze wieder frei
+  for (int i = 0; i < sensors.slots; i++) {
+    if (sensors.sensorList[i].used) {
+      releaseDs2438(sensors.sensorList[i]);
+    }
+    sensors.sensorList[i].used = false;
+  }
 
   // Setze die Anzahl der Sensoren auf 0
-  sensors.count = 0;
+  sensors.count       = 0;
+  sensors.slots       = 0;
+  sensors.freeCount   = 0;
+  sensors.indexCount  = 0;
+}
+
+int bindDs2438(Sensor &sensor) {
+  // Suche einen freien Treiber im Pool und binde ihn an den Sensor
+  for (int i = 0; i < ds2438PoolSize; i++) {
+    if (!ds2438Pool[i].used) {
+      copyDeviceAddress(sensor.deviceAddress, ds2438Pool[i].deviceAddress);
+      ds2438Pool[i].driver = DS2438(&buses[sensor.bus].oneWire, ds2438Pool[i].deviceAddress);
+      ds2438Pool[i].driver.begin(sensor.config.channels);
+      ds2438Pool[i].used = true;
+      sensor.probe = i;
+      return i;
+    }
+  }
+  Serial.println("bindDs2438(): Kein freier DS2438-Treiber, ds2438PoolSize erhöhen");
+  sensor.probe = -1;
+  return -1;
+}
 
-  // Setze den Zeiger auf null, um sicherzustellen, dass er nicht auf ungültigen Speicher zeigt
-  sensors.sensorList = nullptr;
+void releaseDs2438(Sensor &sensor) {
+  if (sensor.probe >= 0 && sensor.probe < ds2438PoolSize) {
+    ds2438Pool[sensor.probe].used = false;
+  }
+  sensor.probe = -1;
 }
 
 void saveConfig() {
@@ -381,12 +739,15 @@ boolean loadConfig() {
   Serial.println("  Lade Konfig");
   // Lies den EEPROM bei Adresse 0 aus
   EEPROM.get(0, tempConfig); 
-  // Die Struct enthält als erstes immer den C-String "MRA-b" und als letztes immer "MRA-e". Prüfe darauf.
-  if (strcmp(tempConfig.head, "MRAb") == 0 && (strcmp(tempConfig.foot, "MRAe") == 0)) {
+  // Die Struct enthält als erstes immer den C-String "MRAc" und als letztes immer "MRAe". Prüfe darauf.
+  if (strcmp(tempConfig.head, "MRAc") == 0 && (strcmp(tempConfig.foot, "MRAe") == 0)) {
     Serial.println("  Konfig erfolgreich geladen:");
     copyConfig(tempConfig, config);
+    indexSensorRecords();
     printConfig(config);
     returnValue = true;
+  } else if (loadLegacyConfig()) {
+    returnValue = true;
   } else {
     Serial.println("  Konfig konnte nicht geladen werden, habe folgendes erhalten:");
     printConfig(tempConfig);
@@ -396,6 +757,311 @@ boolean loadConfig() {
   return returnValue;
 }
 
+boolean loadLegacyConfig() {
+  // Übernimmt eine Konfig in einem der früheren Formate ("MRAb") samt ihrer Sensor-Einträge und speichert sie im neuen
+  BaselineConfig  baseline;
+  LegacyConfig    legacy;
+  DeviceAddress   deviceAddress;
+  SensorConfig    sensorConfig;
+
+  config.sensorRecordLength = 0;
+  memset(config.sensorFormats, 0, sensorFormatBytes);
+
+  EEPROM.get(0, legacy);
+  EEPROM.get(0, baseline);
+  if (strcmp(legacy.connection.head, "MRAb") == 0 && strcmp(legacy.foot, "MRAe") == 0) {
+    Serial.println("  Konfig im früheren Format gefunden, übernehme sie");
+    copyLegacyConfigHead(legacy.connection);
+    // Sensor-Konfig, leere Einträge entfallen
+    for (int i = 0; i < legacySensorConfigCount; i++) {
+      if (hexToDeviceAddress(legacy.sensorConfig[i].address, deviceAddress)) {
+        sensorConfig = legacy.sensorConfig[i].config;
+        sanitizeLegacySensorConfig(sensorConfig);
+        addLegacySensorRecord(deviceAddress, sensorConfig);
+      }
+    }
+  } else if (strcmp(baseline.connection.head, "MRAb") == 0 && strcmp(baseline.foot, "MRAe") == 0) {
+    Serial.println("  Konfig im ursprünglichen Format gefunden, übernehme sie");
+    copyLegacyConfigHead(baseline.connection);
+    // Sensor-Konfig, leere Einträge entfallen, die später hinzugekommenen Felder erhalten ihre Standardwerte
+    for (int i = 0; i < legacySensorConfigCount; i++) {
+      if (hexToDeviceAddress(baseline.sensorConfig[i].address, deviceAddress)) {
+        sensorConfig = SensorConfig();
+        strcpy(sensorConfig.name,   baseline.sensorConfig[i].config.name);
+        strcpy(sensorConfig.format, baseline.sensorConfig[i].config.format);
+        sensorConfig.formatMin  = baseline.sensorConfig[i].config.formatMin;
+        sensorConfig.formatMax  = baseline.sensorConfig[i].config.formatMax;
+        sensorConfig.precision  = baseline.sensorConfig[i].config.precision;
+        sensorConfig.min        = baseline.sensorConfig[i].config.min;
+        sensorConfig.max        = baseline.sensorConfig[i].config.max;
+        addLegacySensorRecord(deviceAddress, sensorConfig);
+      }
+    }
+  } else {
+    return false;
+  }
+  indexSensorRecords();
+  saveConfig();
+  return true;
+}
+
+void copyLegacyConfigHead(const LegacyConfigHead &legacy) {
+  // WiFi
+         config.wifiEnabled  = legacy.wifiEnabled;
+         config.wifiMode     = legacy.wifiMode;
+         config.wifiTimeout  = legacy.wifiTimeout;
+  strcpy(config.wifiSsid,      legacy.wifiSsid);
+  strcpy(config.wifiPass,      legacy.wifiPass);
+
+  // MQTT
+         config.mqttEnabled  = legacy.mqttEnabled;
+  strcpy(config.mqttServer,    legacy.mqttServer);
+  strcpy(config.mqttUser,      legacy.mqttUser);
+         config.mqttPort     = legacy.mqttPort;
+  strcpy(config.mqttName,      legacy.mqttName);
+  strcpy(config.mqttPassword,  legacy.mqttPassword);
+}
+
+void addLegacySensorRecord(const DeviceAddress deviceAddress, const SensorConfig &sensorConfig) {
+  // Die früheren 10 Einträge passen immer in sensorRecords, ein Fehlschlag wird trotzdem gemeldet
+  if (!addSensorRecord(config, deviceAddress, sensorConfig)) {
+    Serial.print("  Eintrag für ");
+    Serial.print(sensorConfig.name);
+    Serial.println(" konnte nicht übernommen werden");
+  }
+}
+
+void sanitizeLegacySensorConfig(SensorConfig &sensorConfig) {
+  /*
+    channels, resolution und alarmLow/alarmHigh kamen nacheinander hinzu, ohne dass sich der head "MRAb" änderte. 
+    Alle diese Stände haben dieselbe Größe, in einem älteren Stand liegen an deren Stelle aber Füllbytes. Unbrauchbare 
+    Werte werden daher durch die Standardwerte ersetzt.
+  */
+  if (sensorConfig.channels == 0 || (sensorConfig.channels & ~(DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE)) != 0) {
+    sensorConfig.channels = DS2438_MODE_CHA;
+  }
+  if (sensorConfig.resolution < 9 || sensorConfig.resolution > 12) {
+    sensorConfig.resolution = 12;
+  }
+  if (!hasAlarmBand(sensorConfig)) {
+    sensorConfig.alarmLow  = sensorAlarmLowOff;
+    sensorConfig.alarmHigh = sensorAlarmHighOff;
+  }
+}
+
+boolean getSensorRecord(const Config &source, const int offset, DeviceAddress deviceAddress, SensorConfig &output, int &length) {
+  // Liest den Eintrag ab offset samt seines Format-Strings, false am Ende der Einträge oder bei einem beschädigten Eintrag
+  int         formatIndex;
+  const char* format;
+
+  if (offset >= source.sensorRecordLength || source.sensorRecordLength > sensorRecordBytes) {
+    return false;
+  }
+  length = decodeSensorRecord(&source.sensorRecords[offset], source.sensorRecordLength - offset, deviceAddress, output, formatIndex);
+  if (length == 0) {
+    return false;
+  }
+  if (formatIndex >= 0) {
+    format = getInternedFormat(source.sensorFormats, sensorFormatBytes, formatIndex);
+    if (format != nullptr) {
+      strncpy(output.format, format, sizeof(SensorValueFormat) - 1);
+      output.format[sizeof(SensorValueFormat) - 1] = '\0';
+    }
+  }
+  return true;
+}
+
+boolean addSensorRecord(Config &target, const DeviceAddress deviceAddress, const SensorConfig &sensorConfig) {
+  // Hängt einen Eintrag an die Sensor-Konfig an, false wenn kein Platz mehr ist
+  int formatIndex = -1;
+  int length;
+
+  if (strcmp(sensorConfig.format, SensorConfig().format) != 0) {
+    formatIndex = internFormat(target.sensorFormats, sensorFormatBytes, sensorConfig.format);
+    if (formatIndex < 0) {
+      Serial.println("addSensorRecord(): Kein Platz für weitere Format-Strings, sensorFormatBytes erhöhen");
+      return false;
+    }
+  }
+  length = encodeSensorRecord(deviceAddress, sensorConfig, formatIndex, &target.sensorRecords[target.sensorRecordLength], sensorRecordBytes - target.sensorRecordLength);
+  if (length == 0) {
+    Serial.println("addSensorRecord(): Kein Platz für weitere Sensor-Einträge, sensorRecordBytes erhöhen");
+    return false;
+  }
+  // Ein Eintrag ohne abweichende Felder entspricht keinem Eintrag und wird nicht gespeichert
+  if (length > 9) {
+    target.sensorRecordLength += length;
+  }
+  return true;
+}
+
+void indexSensorRecords() {
+  // Ein Durchlauf über alle Einträge: Prüfe sie und merk dir ihren Beginn für getSensorConfig()
+  DeviceAddress deviceAddress;
+  SensorConfig  sensorConfig;
+  int           length;
+  int           offset = 0;
+
+  configRecordCount = 0;
+  while (offset < config.sensorRecordLength) {
+    if (!getSensorRecord(config, offset, deviceAddress, sensorConfig, length)) {
+      Serial.println("indexSensorRecords(): Beschädigter Eintrag, verwerfe die restlichen Einträge");
+      config.sensorRecordLength = offset;
+      break;
+    }
+    // Kann nur ein beschädigter Eintrag mit weniger als 10 Bytes auslösen, auch dann nichts stillschweigend übergehen
+    if (configRecordCount >= sensorRecordCount) {
+      Serial.println("indexSensorRecords(): Zu viele Einträge, verwerfe die restlichen Einträge");
+      config.sensorRecordLength = offset;
+      break;
+    }
+    configRecordOffsets[configRecordCount++] = offset;
+    offset += length;
+  }
+}
+
+boolean loadTopology() {
+  Topology tempTopology;
+
+  Serial.println("loadTopology() begin");
+  topologyStorage.read(tempTopology);
+  // Wie die Konfig ist der Cache durch Anfang und Ende gekennzeichnet, nach dem Upload ist der Flash leer
+  if (strcmp(tempTopology.head, "MRAt") == 0 && strcmp(tempTopology.foot, "MRAu") == 0 && tempTopology.count <= topologyCacheCount) {
+    topology = tempTopology;
+    Serial.print("  Geräte im Cache: ");
+    Serial.println(topology.count);
+    Serial.println("loadTopology() end");
+    return true;
+  }
+  topology = Topology();
+  Serial.println("  Kein gültiger Cache vorhanden");
+  Serial.println("loadTopology() end");
+  return false;
+}
+
+boolean loadCalibrations() {
+  Calibrations tempCalibrations;
+
+  Serial.println("loadCalibrations() begin");
+  calibrationStorage.read(tempCalibrations);
+  if (strcmp(tempCalibrations.head, "MRAk") == 0 && strcmp(tempCalibrations.foot, "MRAl") == 0 && tempCalibrations.count <= calibrationCount) {
+    calibrations = tempCalibrations;
+    Serial.print("  Kalibrier-Tabellen: ");
+    Serial.println(calibrations.count);
+    Serial.println("loadCalibrations() end");
+    return true;
+  }
+  calibrations = Calibrations();
+  Serial.println("  Keine Kalibrier-Tabellen vorhanden");
+  Serial.println("loadCalibrations() end");
+  return false;
+}
+
+void saveCalibrations() {
+  Serial.print("saveCalibrations(): Speichere ");
+  Serial.print(calibrations.count);
+  Serial.println(" Kalibrier-Tabellen");
+  calibrationStorage.write(calibrations);
+}
+
+int findCalibration(const DeviceAddress deviceAddress) {
+  // Index der Kalibrier-Tabelle des Sensors in calibrations.entries, -1 wenn er keine hat
+  for (int i = 0; i < calibrations.count; i++) {
+    if (memcmp(calibrations.entries[i].address, deviceAddress, sizeof(DeviceAddress)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void applyCalibration(const int index) {
+  // Übersetzt den Formatierer des Sensors neu, samt seiner Kalibrier-Tabelle, sofern er eine hat
+  Sensor &sensor  = sensors.sensorList[index];
+  int     entry   = findCalibration(sensor.deviceAddress);
+
+  compileSensorFormatter(sensor);
+  if (entry >= 0) {
+    compileCalibration(sensor, calibrations.entries[entry], calibrationPool[entry]);
+  }
+  snapshotStale = true;
+}
+
+void saveTopology(const boolean immediate) {
+  /*
+    Übernimmt die aktuelle Sensorliste in den Cache. Geschrieben wird nur bei einer Änderung, um den Flash zu schonen.
+    Im Betrieb (nach jedem Suchlauf) muss die Änderung zudem topologySaveDelay unverändert bestehen und der letzte 
+    Schreibvorgang topologySaveInterval zurückliegen. Ein wackeliger Sensor, der kommt und geht, schreibt so nicht 
+    bei jedem Suchlauf. Verglichen wird unabhängig von der Reihenfolge, da ein wieder aufgenommener Sensor einen 
+    anderen Platz erhalten kann.
+  */
+  Topology  current;
+  boolean   changed;
+  uint32_t  signature = 0;
+
+  if (dummySensors) {
+    return;
+  }
+  for (int b = 0; b < oneWireBusCount; b++) {
+    current.parasite[b] = buses[b].parasite;
+    signature = signature * 31 + current.parasite[b];
+  }
+  for (int i = 0; i < sensors.slots && current.count < topologyCacheCount; i++) {
+    if (!sensors.sensorList[i].used || sensors.sensorList[i].type == T_VIRTUAL) {
+      continue;
+    }
+    TopologyEntry &entry = current.entries[current.count++];
+    copyDeviceAddress(sensors.sensorList[i].deviceAddress, entry.address);
+    entry.bus         = sensors.sensorList[i].bus;
+    entry.type        = sensors.sensorList[i].type;
+    entry.resolution  = sensors.sensorList[i].config.resolution;
+    entry.alarmLow    = sensors.sensorList[i].config.alarmLow;
+    entry.alarmHigh   = sensors.sensorList[i].config.alarmHigh;
+    // Summe der Einträge, damit die Reihenfolge keine Rolle spielt
+    signature += (uint32_t)deviceAddressToRom(entry.address) ^ (uint32_t)(deviceAddressToRom(entry.address) >> 32) ^
+                 ((uint32_t)entry.bus << 24 | (uint32_t)(uint8_t)entry.type << 16 | (uint32_t)entry.resolution << 8) ^
+                 ((uint32_t)(uint8_t)entry.alarmLow << 8 | (uint8_t)entry.alarmHigh);
+  }
+
+  changed = current.count != topology.count;
+  for (int b = 0; b < oneWireBusCount && !changed; b++) {
+    changed = current.parasite[b] != topology.parasite[b];
+  }
+  for (int i = 0; i < current.count && !changed; i++) {
+    changed = true;
+    for (int j = 0; j < topology.count && changed; j++) {
+      changed = memcmp(current.entries[i].address, topology.entries[j].address, 8) != 0 ||
+                current.entries[i].bus        != topology.entries[j].bus ||
+                current.entries[i].type       != topology.entries[j].type ||
+                current.entries[i].resolution != topology.entries[j].resolution ||
+                current.entries[i].alarmLow   != topology.entries[j].alarmLow ||
+                current.entries[i].alarmHigh  != topology.entries[j].alarmHigh;
+    }
+  }
+  if (!changed) {
+    topologyPending = false;
+    return;
+  }
+  if (!immediate) {
+    if (!topologyPending || signature != topologyPendingSignature) {
+      topologyPending           = true;
+      topologyPendingSignature  = signature;
+      topologyPendingSince      = millis();
+      return;
+    }
+    if (millis() - topologyPendingSince < topologySaveDelay * 1000UL || millis() - topologySavedAt < topologySaveInterval * 1000UL) {
+      return;
+    }
+  }
+
+  Serial.print("saveTopology(): Speichere ");
+  Serial.print(current.count);
+  Serial.println(" Geräte im Cache");
+  topology        = current;
+  topologyStorage.write(topology);
+  topologyPending = false;
+  topologySavedAt = millis();
+}
+
 void htmlGetHeader(int refresh) {
   // HTTP headers always start with a response code (e.g. HTTP/1.1 200 OK)
   // and a content-type so the client knows what's coming, then a blank line:
@@ -416,7 +1082,40 @@ void htmlGetHeader(int refresh) {
   client.print("</head>");
 }
 
+void htmlGetSensorConfigRow(const int row, const char *address, const SensorConfig &sensorConfig, const DeviceAddress deviceAddress) {
+  char channels[4];
+  char calibration[calibrationTextSize] = "";
+  int  entry = deviceAddress == nullptr ? -1 : findCalibration(deviceAddress);
+
+  channelsToStr(sensorConfig.channels, channels);
+  if (entry >= 0) {
+    calibrationToStr(calibrations.entries[entry], calibration);
+  }
+  client.print("        <tr>");  
+  client.print("          <td>" + String(row) + "</td>");  
+  client.print("          <td><input type='text' name='sensorAddress"        + String(row) + "' value='" + String(address)                   + "'></td>");  
+  client.print("          <td><input type='text' name='sensorName"           + String(row) + "' value='" + String(sensorConfig.name)         + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValueFormat"    + String(row) + "' value='" + String(sensorConfig.format)       + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValueFormatMin" + String(row) + "' value='" + String(sensorConfig.formatMin)    + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValueFormatMax" + String(row) + "' value='" + String(sensorConfig.formatMax)    + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValuePrecision" + String(row) + "' value='" + String(sensorConfig.precision)    + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValueMin"       + String(row) + "' value='" + String(sensorConfig.min)          + "'></td>");  
+  client.print("          <td><input type='text' name='sensorValueMax"       + String(row) + "' value='" + String(sensorConfig.max)          + "'></td>");  
+  client.print("          <td><input type='text' name='sensorChannels"       + String(row) + "' value='" + String(channels)                  + "'></td>");  
+  client.print("          <td><input type='text' name='sensorResolution"     + String(row) + "' value='" + String(sensorConfig.resolution)   + "'></td>");  
+  client.print("          <td><input type='text' name='sensorAlarmLow"       + String(row) + "' value='" + (sensorConfig.alarmLow  == sensorAlarmLowOff  ? String("") : String(sensorConfig.alarmLow))  + "'></td>");  
+  client.print("          <td><input type='text' name='sensorAlarmHigh"      + String(row) + "' value='" + (sensorConfig.alarmHigh == sensorAlarmHighOff ? String("") : String(sensorConfig.alarmHigh)) + "'></td>");  
+  client.print("          <td><input type='text' name='sensorCalibration"    + String(row) + "' value='" + String(calibration)               + "'></td>");  
+  client.print("        </tr>");  
+}
+
 void htmlGetConfig() {
+  DeviceAddress deviceAddress;
+  SensorAddress address;
+  SensorConfig  sensorConfig;
+  int           length;
+  int           row = 0;
+
   htmlGetHeader(0);
   client.print("<html>");
   client.print("  <body>");
@@ -446,21 +1145,35 @@ void htmlGetConfig() {
   client.print("        <th>Dezimalstellen</th>");
   client.print("        <th>Sensorwert Min</th>");
   client.print("        <th>Sensorwert Max</th>");
-  for (int i = 0; i < sensorConfigCount; i++) {
-    client.print("        <tr>");  
-    client.print("          <td>" + String(i) + "</td>");  
-    client.print("          <td><input type='text' name='sensorAddress"        + String(i) + "' value='" + String(config.sensorConfig[i].address)   + "'></td>");  
-    client.print("          <td><input type='text' name='sensorName"           + String(i) + "' value='" + String(config.sensorConfig[i].config.name)      + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValueFormat"    + String(i) + "' value='" + String(config.sensorConfig[i].config.format)    + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValueFormatMin" + String(i) + "' value='" + String(config.sensorConfig[i].config.formatMin) + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValueFormatMax" + String(i) + "' value='" + String(config.sensorConfig[i].config.formatMax) + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValuePrecision" + String(i) + "' value='" + String(config.sensorConfig[i].config.precision) + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValueMin"       + String(i) + "' value='" + String(config.sensorConfig[i].config.min)       + "'></td>");  
-    client.print("          <td><input type='text' name='sensorValueMax"       + String(i) + "' value='" + String(config.sensorConfig[i].config.max)       + "'></td>");  
-    client.print("        </tr>");  
+  client.print("        <th>Kan&auml;le (A/B/T)</th>");
+  client.print("        <th>Aufl&ouml;sung (9-12 Bit)</th>");
+  client.print("        <th>Alarm Min (&deg;C)</th>");
+  client.print("        <th>Alarm Max (&deg;C)</th>");
+  client.print("        <th>Kalibrierung (Messwert:Wert ...)</th>");
+  // Konfigurierte Sensoren
+  for (int i = 0; i < configRecordCount; i++) {
+    getSensorRecord(config, configRecordOffsets[i], deviceAddress, sensorConfig, length);
+    deviceAddressToHex(deviceAddress, address);
+    htmlGetSensorConfigRow(row++, address, sensorConfig, deviceAddress);
   }
+  // Erkannte Sensoren ohne Eintrag, mit Standardwerten vorbelegt
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used || getSensorConfig(sensors.sensorList[i].deviceAddress, sensorConfig)) {
+      continue;
+    }
+    htmlGetSensorConfigRow(row++, sensors.sensorList[i].address, SensorConfig(), sensors.sensorList[i].deviceAddress);
+  }
+  // Eine leere Zeile für einen weiteren Sensor
+  htmlGetSensorConfigRow(row++, "", SensorConfig(), nullptr);
   client.print("      </table>");
 
+  client.print("      <p>Abgeleitete Sensoren, z.B. ({Feuchte.A} / {Feuchte.B} - 0.16) / 0.0062</p>");
+  for (int i = 0; i < virtualSensorCount; i++) {
+    virtualSensorAddress(i, deviceAddress);
+    deviceAddressToHex(deviceAddress, address);
+    client.print("      <p>" + String(address) + ": <input type='text' size='50' name='virtualExpression" + String(i) + "' value='" + String(virtualSensors.expressions[i]) + "'></p>");
+  }
+
   client.print("      <input type='submit' value='Speichern'>");
   client.print("    </form>");
   client.print("    <br/>");
@@ -478,9 +1191,15 @@ void htmlGetConfig() {
 }
 
 void htmlSetConfig() {
-  char c;
-  char no[2];
-  char name[21];
+  char          c;
+  char          no[4];
+  char          name[24];
+  char*         value;
+  int           rows;
+  int           dropped = 0;
+  DeviceAddress     deviceAddress;
+  SensorConfig      sensorConfig;
+  SensorCalibration calibration;
   Serial.println("htmlSetConfig() begin");
   // Lese den HTTP-Body, der die aktualisierten Daten enthält
   String body = "";
@@ -493,61 +1212,191 @@ void htmlSetConfig() {
 
 // Wifi
   config.wifiEnabled = body.indexOf("wifiEnabled=on") != -1;
-  strcpy(config.wifiSsid, getValue(body, "wifiSsid"));
-  strcpy(config.wifiPass, getValue(body, "wifiPass"));
-  config.wifiMode = getValue(body, "wifiMode")[0];
-  config.wifiTimeout = atoi(getValue(body, "wifiTimeout")); // Umwandlung in Integer
+  // Fehlende Felder behalten ihren bisherigen Wert, zu lange werden gekürzt
+  copyValue(body, "wifiSsid", config.wifiSsid, sizeof(config.wifiSsid));
+  copyValue(body, "wifiPass", config.wifiPass, sizeof(config.wifiPass));
+  if ((value = getValue(body, "wifiMode")) != nullptr && value[0] != '\0') {
+    config.wifiMode = value[0];
+  }
+  if ((value = getValue(body, "wifiTimeout")) != nullptr) {
+    config.wifiTimeout = atoi(value); // Umwandlung in Integer
+  }
 
   // MQTT
   config.mqttEnabled = body.indexOf("mqttEnabled=on") != -1;
-  strcpy(config.mqttServer, getValue(body, "mqttServer"));
+  copyValue(body, "mqttServer", config.mqttServer, sizeof(config.mqttServer));
   Serial.print("mqttServer: ");
   Serial.println(config.mqttServer);
-  config.mqttPort = atoi(getValue(body, "mqttPort")); // Umwandlung in Integer
-  strcpy(config.mqttName, getValue(body, "mqttName"));
-  strcpy(config.mqttUser, getValue(body, "mqttUser"));
-  strcpy(config.mqttPassword, getValue(body, "mqttPassword"));
-
-  for (int i = 0; i < sensorConfigCount; i++) {
+  if ((value = getValue(body, "mqttPort")) != nullptr) {
+    config.mqttPort = atoi(value); // Umwandlung in Integer
+  }
+  copyValue(body, "mqttName", config.mqttName, sizeof(config.mqttName));
+  copyValue(body, "mqttUser", config.mqttUser, sizeof(config.mqttUser));
+  copyValue(body, "mqttPassword", config.mqttPassword, sizeof(config.mqttPassword));
+
+  // Baue die Sensor-Konfig und die Kalibrier-Tabellen aus den Zeilen neu auf, Zeilen ohne gültige Adresse entfallen.
+  // Das Formular hat höchstens so viele Zeilen, wie htmlGetConfig() ausgegeben hat, mehr werden nicht gelesen.
+  rows = configRecordCount + sensors.count + 1;
+  config.sensorRecordLength = 0;
+  memset(config.sensorFormats, 0, sensorFormatBytes);
+  calibrations.count = 0;
+  for (int i = 0; i < rows; i++) {
     itoa(i, no, 10);
 
     strcpy(name, "sensorAddress");
     strcat(name, no);
-    strcpy(config.sensorConfig[i].address, getValue(body, name));
-
+    value = getValue(body, name);
+    if (value == nullptr) {
+      break;
+    }
+    if (!hexToDeviceAddress(value, deviceAddress)) {
+      continue;
+    }
+    sensorConfig = SensorConfig();
     strcpy(name, "sensorName");
     strcat(name, no);
-    strcpy(config.sensorConfig[i].config.name, getValue(body, name));
+    copyValue(body, name, sensorConfig.name, sizeof(sensorConfig.name));
 
     strcpy(name, "sensorValueFormat");
     strcat(name, no);
-    strcpy(config.sensorConfig[i].config.format, getValue(body, name));
+    copyValue(body, name, sensorConfig.format, sizeof(sensorConfig.format));
 
     strcpy(name, "sensorValueFormatMin");
     strcat(name, no);
-    config.sensorConfig[i].config.formatMin = atof(getValue(body, name)); // Umwandlung nach Float
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.formatMin = atof(value); // Umwandlung nach Float
+    }
 
     strcpy(name, "sensorValueFormatMax");
     strcat(name, no);
-    config.sensorConfig[i].config.formatMax = atof(getValue(body, name)); // Umwandlung nach Float
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.formatMax = atof(value); // Umwandlung nach Float
+    }
 
     strcpy(name, "sensorValuePrecision");
     strcat(name, no);
-    config.sensorConfig[i].config.precision = atoi(getValue(body, name)); // Umwandlung nach Int
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.precision = atoi(value); // Umwandlung nach Int
+    }
 
     strcpy(name, "sensorValueMin");
     strcat(name, no);
-    config.sensorConfig[i].config.min = atof(getValue(body, name)); // Umwandlung nach Float
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.min = atof(value); // Umwandlung nach Float
+    }
 
     strcpy(name, "sensorValueMax");
     strcat(name, no);
-    config.sensorConfig[i].config.max = atof(getValue(body, name)); // Umwandlung nach Float
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.max = atof(value); // Umwandlung nach Float
+    }
+
+    strcpy(name, "sensorChannels");
+    strcat(name, no);
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.channels = strToChannels(value); // Umwandlung nach Kanal-Maske
+    }
+
+    strcpy(name, "sensorResolution");
+    strcat(name, no);
+    if ((value = getValue(body, name)) != nullptr) {
+      sensorConfig.resolution = constrain(atoi(value), 9, 12); // Umwandlung nach Int, 9 bis 12 Bit
+    }
+
+    strcpy(name, "sensorAlarmLow");
+    strcat(name, no);
+    sensorConfig.alarmLow = strToAlarm(getValue(body, name), sensorAlarmLowOff); // Leer = keine Schwelle
+
+    strcpy(name, "sensorAlarmHigh");
+    strcat(name, no);
+    sensorConfig.alarmHigh = strToAlarm(getValue(body, name), sensorAlarmHighOff); // Leer = keine Schwelle
+  
+    if (!addSensorRecord(config, deviceAddress, sensorConfig)) {
+      dropped++;
+    }
+
+    strcpy(name, "sensorCalibration");
+    strcat(name, no);
+    if (strToCalibration(getValue(body, name), calibration)) {
+      if (calibrations.count < calibrationCount) {
+        copyDeviceAddress(deviceAddress, calibration.address);
+        calibrations.entries[calibrations.count++] = calibration;
+      } else {
+        Serial.println("  Kein Platz für weitere Kalibrier-Tabellen, calibrationCount erhöhen");
+      }
+    }
+  }
+  if (dropped > 0) {
+    Serial.print("  Konfig von ");
+    Serial.print(dropped);
+    Serial.println(" Sensoren nicht gespeichert, kein Platz mehr in sensorRecords");
+  }
+  indexSensorRecords();
+  saveCalibrations();
+
+  // Die Tabellen haben neue Plätze in calibrationPool, übersetze die Formatierer aller Sensoren neu
+  for (int i = 0; i < sensors.slots; i++) {
+    if (sensors.sensorList[i].used) {
+      applyCalibration(i);
+    }
+  }
+
+  // Abgeleitete Sensoren
+  for (int i = 0; i < virtualSensorCount; i++) {
+    itoa(i, no, 10);
+    strcpy(name, "virtualExpression");
+    strcat(name, no);
+    value = getValue(body, name);
+    if (value != nullptr) {
+      strncpy(virtualSensors.expressions[i], value, virtualExpressionSize - 1);
+      virtualSensors.expressions[i][virtualExpressionSize - 1] = '\0';
+    }
   }
+  saveVirtualSensors();
+  setupVirtualSensors();
 
   saveConfig();
   Serial.println("htmlSetConfig() begin");
 }
 
+void htmlGetProfile() {
+  client.println("HTTP/1.1 200 OK");
+  client.println("Content-type:text/plain");
+  client.println();
+  printProfile(client);
+  printProfile(Serial);
+}
+
+void htmlStartStream(const String &request) {
+  char* value;
+  int   index   = -1;
+  int   channel = DS2438_CHA;
+
+  value = getValue(request, "sensor");
+  if (value != nullptr) {
+    index = atoi(value);
+  }
+  value = getValue(request, "channel");
+  if (value != nullptr && (value[0] == 'B' || value[0] == 'b')) {
+    channel = DS2438_CHB;
+  }
+
+  // Der Rest der Anfrage wird verworfen, sonst würde er beim nächsten Aufruf als neue Anfrage gelesen
+  while (client.available()) {
+    client.read();
+  }
+
+  client.println("HTTP/1.1 200 OK");
+  client.println("Content-type:text/plain");
+  client.println();
+  if (!startStream(index, channel)) {
+    client.println("Kein DS2438 mit diesem Index");
+    return;
+  }
+  client.println("Zeit [ms];Spannung [V]");
+  streamClient = client;
+}
+
 void htmlGetStatus() {
   htmlGetHeader(2);
   // client.print("<html><body>");  // ohne  korrektem html und body passt die Schriftgröße irgendwie immer
@@ -555,6 +1404,9 @@ void htmlGetStatus() {
   client.print("Sensoren: </br>");
   client.print(getValuesAsHtml());
   client.print("<br/>");
+  if (streamState != STREAM_OFF) {
+    client.print("Streaming: " + String(sensors.sensorList[streamSensor].address) + ", " + String(streamSamples) + " Messwerte <a href=\"/stream/stop\">Beenden</a><br/>");
+  }
   client.print("<a href=\"/config\">Konfiguration</a><br/>");
   client.print("</p>");
   client.print("</html>");
@@ -566,6 +1418,7 @@ void htmlGetStatus() {
 void httpProcessRequests() {
 String currentLine = "";
 char c;
+boolean keepOpen = false;
 
   // Vergleich den aktuellen mit dem vorherigen Status
   if (status != WiFi.status()) {
@@ -632,6 +1485,37 @@ char c;
           break;
         }
 
+        // "Profil zurücksetzen"
+        if (currentLine.endsWith("GET /profile/reset")) {
+          Serial.println("  GET /profile/reset => Profil zurücksetzen");
+          resetProfile();
+          htmlGetStatus();
+          break;
+        }
+
+        // "Profil anzeigen", erst wenn die Anfrage-Zeile vollständig ist, damit /profile/reset nicht vorher greift
+        if (currentLine.endsWith("GET /profile HTTP/1.1")) {
+          Serial.println("  GET /profile => Profil anzeigen");
+          htmlGetProfile();
+          break;
+        }
+
+        // "Streaming beenden"
+        if (currentLine.endsWith("GET /stream/stop")) {
+          Serial.println("  GET /stream/stop => Streaming beenden");
+          stopStream();
+          htmlGetStatus();
+          break;
+        }
+
+        // "Streaming starten", z.B. /stream?sensor=2&channel=B, erst wenn die Anfrage-Zeile vollständig ist
+        if (currentLine.startsWith("GET /stream?") && currentLine.endsWith(" HTTP/1.1")) {
+          Serial.println("  GET /stream => Streaming starten");
+          htmlStartStream(currentLine.substring(0, currentLine.indexOf(" HTTP/1.1")));
+          keepOpen = streamState != STREAM_OFF;
+          break;
+        }
+
         // "Konfiguration speichern"
         if (currentLine.indexOf("POST") != -1) {
           htmlSetConfig();
@@ -657,9 +1541,11 @@ char c;
       }
     }
 
-    // Verbindung schließen
-    client.stop();
-    Serial.println("Client getrennt");
+    // Verbindung schließen, außer sie wurde an das Streaming übergeben
+    if (!keepOpen) {
+      client.stop();
+      Serial.println("Client getrennt");
+    }
   } else {
     // Kein neuer Client
   }
@@ -668,168 +1554,213 @@ char c;
 
 void printSensors() {
   Serial.println("  Anzahl Sensoren im Array: " + String(sensors.count));
-  for (int i = 0; i < sensors.count; i++) {
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
     Serial.print("  Sensor " + String(i) + " Adresse: ");
     Serial.print(sensors.sensorList[i].address);
     Serial.print(" Name: ");
     Serial.print(sensors.sensorList[i].config.name);
     Serial.print(" Typ: ");
-    Serial.print(sensors.sensorList[i].type);
+    Serial.print((int)sensors.sensorList[i].type);
+    Serial.print(" Bus: ");
+    Serial.print(sensors.sensorList[i].bus);
     Serial.print(" Wert: ");
-    Serial.println(sensors.sensorList[i].value);
+    Serial.print(sensors.sensorList[i].raw);
+    Serial.print("/");
+    Serial.println(sensors.sensorList[i].unit);
   }
 }
 
-void addSensor(Sensor sensor) {
-  Sensor*   tempArray = (Sensor*)malloc((sensors.count + 1) * sizeof(Sensor));
-  DeviceAddress tempDs2438DeviceAddress;
+int addSensor(const Sensor &sensor) {
+  int index;
 
   Serial.println("addSensor(): begin");
 
-  // Übertrage vorhandene Daten in das temporäre Array
-  for (int i = 0; i < sensors.count; i++) {
-    tempArray[i] = sensors.sensorList[i];
+  // Planung und Abfrage greifen per bus auf buses[] zu
+  if (sensor.bus >= oneWireBusCount) {
+    Serial.print("  Ungültiger Bus ");
+    Serial.println(sensor.bus);
+    Serial.println("addSensor(): end");
+    return -1;
+  }
+
+  // Nimm zuerst einen freigegebenen Platz, sonst den nächsten unbenutzten
+  if (sensors.freeCount > 0) {
+    index = sensors.freeSlots[--sensors.freeCount];
+  } else if (sensors.slots < sensorCapacity) {
+    index = sensors.slots++;
+  } else {
+    Serial.println("  Sensorliste voll, SENSOR_CAPACITY erhöhen");
+    Serial.println("addSensor(): end");
+    return -1;
   }
 
   // Füge das neue Sensorobjekt hinzu
   Serial.print("  Füge Sensor ");
   Serial.print(sensor.address);
+  Serial.print(" auf Platz ");
+  Serial.print(index);
   Serial.println(" hinzu");
-  strcpy(tempArray[sensors.count].address, sensor.address);
-  tempArray[sensors.count].type = sensor.type;
-  strcpy(tempArray[sensors.count].config.name, sensor.config.name);
-  strcpy(tempArray[sensors.count].config.format, sensor.config.format);
-  tempArray[sensors.count].config.formatMin = sensor.config.formatMin;
-  tempArray[sensors.count].config.formatMax = sensor.config.formatMax;
-  tempArray[sensors.count].config.precision = sensor.config.precision;
-  tempArray[sensors.count].config.min = sensor.config.min;
-  tempArray[sensors.count].config.max = sensor.config.max;
-  tempArray[sensors.count].value = sensor.value;
-  strToDeviceAddress(String(sensor.address), tempDs2438DeviceAddress);
-  copyDeviceAddress(tempDs2438DeviceAddress, tempArray[sensors.count].deviceAddress);
+  sensors.sensorList[index]       = sensor;
+  sensors.sensorList[index].used  = true;
+  // Die Bus-Erkennung beginnt für jeden neuen Sensor von vorn, auch wenn der Aufrufer einen gebrauchten übergibt
+  sensors.sensorList[index].seen    = false;
+  sensors.sensorList[index].missed  = 0;
+  // Scharf geschaltet wird erst mit dem ersten gültigen Wert, siehe rescheduleDueSensors()
+  sensors.sensorList[index].alarmArmed  = false;
+  sensors.sensorList[index].alarmHit    = false;
+  applyCalibration(index);
 
   // Erhöhe die Anzahl der Sensoren
   sensors.count++;
 
-  // Befreie den alten Speicher
-  free(sensors.sensorList);
-
-  // Weise den neuen Speicher zu
-  sensors.sensorList = tempArray;
+  // Nimm den Sensor in den Index auf
+  indexSensor(index);
 
   Serial.println("addSensor(): end");
+  return index;
 }
 
 [[deprecated("Diese Funktion wird eigentlich nicht mehr gebraucht, da es eine Version gibt, die eine Sensor-Struct annimmt")]]
-void addSensor(const SensorAddress address, const SensorName name, const SensorType type, const SensorValueFormat format, const SensorValueFormatMin formatMin, const SensorValueFormatMax formatMax, const SensorValuePrecision precision, const SensorValueMin min, const SensorValueMax max, float value) {
-  Sensor*   tempArray = (Sensor*)malloc((sensors.count + 1) * sizeof(Sensor));
-  DeviceAddress tempDs2438DeviceAddress;
+int addSensor(const SensorAddress address, const SensorName name, const SensorType type, const SensorValueFormat format, const SensorValueFormatMin formatMin, const SensorValueFormatMax formatMax, const SensorValuePrecision precision, const SensorValueMin min, const SensorValueMax max, float value) {
+  Sensor sensor;
+
+  strcpy(sensor.address, address);
+  strcpy(sensor.config.name, name);
+  sensor.type = type;
+  sensor.bus = 0;
+  strcpy(sensor.config.format, format);
+  sensor.config.formatMin = formatMin;
+  sensor.config.formatMax = formatMax;
+  sensor.config.min = min;
+  sensor.config.max = max;
+  sensor.config.precision = precision;
+  sensor.unit = getSensorUnit(type, sensor.config.channels);
+  sensor.raw = lround(value * sensor.unit);
+  // Ohne gültigen ROM-Code wäre der Schlüssel 00…00, doppelt im Index und gleich der Familie abgeleiteter Sensoren
+  if (!hexToDeviceAddress(address, sensor.deviceAddress)) {
+    Serial.print("addSensor(): Ungültige Adresse ");
+    Serial.println(address);
+    return -1;
+  }
+  return addSensor(sensor);
+}
 
-  Serial.println("addSensor(): begin");
+void indexSensor(const int index) {
+  // Sortiere den ROM-Code des Sensors per Einfügen in den Index ein
+  SensorRom rom = deviceAddressToRom(sensors.sensorList[index].deviceAddress);
+  int       pos = sensors.indexCount;
 
-  // Übertrage vorhandene Daten in das temporäre Array
-  for (int i = 0; i < sensors.count; i++) {
-    tempArray[i] = sensors.sensorList[i];
+  if (sensors.indexCount >= sensorIndexSize) {
+    Serial.println("indexSensor(): Index voll, sensorIndexSize erhöhen");
+    return;
+  }
+  while (pos > 0 && sensors.romIndex[pos - 1].rom > rom) {
+    sensors.romIndex[pos] = sensors.romIndex[pos - 1];
+    pos--;
   }
+  sensors.romIndex[pos].rom   = rom;
+  sensors.romIndex[pos].index = index;
+  sensors.indexCount++;
+}
 
-  // Füge das neue Sensorobjekt hinzu
-  Serial.print("  Füge Sensor ");
-  Serial.print(address);
-  Serial.println(" hinzu");
-  strcpy(tempArray[sensors.count].address, address);
-  strcpy(tempArray[sensors.count].config.name, name);
-  tempArray[sensors.count].type = type;
-  strcpy(tempArray[sensors.count].config.format, format);
-  tempArray[sensors.count].config.formatMin = formatMin;
-  tempArray[sensors.count].config.formatMax = formatMax;
-  tempArray[sensors.count].config.min = min;
-  tempArray[sensors.count].config.max = max;
-  tempArray[sensors.count].config.precision = precision;
-  tempArray[sensors.count].value = value;
-  strToDeviceAddress(String(address), tempDs2438DeviceAddress);
-  copyDeviceAddress(tempDs2438DeviceAddress, tempArray[sensors.count].deviceAddress);
+void unindexSensor(const int index) {
+  // Entferne den Sensor aus dem Index, die übrigen Einträge rücken nach
+  int pos = 0;
 
-  // Erhöhe die Anzahl der Sensoren
-  sensors.count++;
+  for (int i = 0; i < sensors.indexCount; i++) {
+    if (sensors.romIndex[i].index != index) {
+      sensors.romIndex[pos++] = sensors.romIndex[i];
+    }
+  }
+  sensors.indexCount = pos;
+}
+
+int findSensorByRom(const SensorRom rom) {
+  // Binäre Suche im Index
+  int low  = 0;
+  int high = sensors.indexCount - 1;
+  int mid;
+
+  while (low <= high) {
+    mid = (low + high) / 2;
+    if (sensors.romIndex[mid].rom == rom) {
+      return sensors.romIndex[mid].index;
+    }
+    if (sensors.romIndex[mid].rom < rom) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return -1;
+}
 
-  // Befreie den alten Speicher
-  free(sensors.sensorList);
+boolean updateSensorValue(const SensorRom rom, const SensorRaw raw) {
+  int index = findSensorByRom(rom);
 
-  // Weise den neuen Speicher zu
-  sensors.sensorList = tempArray;
+  if (index < 0) {
+    return false;
+  }
+  sensors.sensorList[index].raw = raw;
+  return true;
+}
 
-  Serial.println("addSensor(): end");
+boolean getSensorType(const SensorRom rom, SensorType& type) {
+  int index = findSensorByRom(rom);
+
+  if (index < 0) {
+    return false;
+  }
+  type = sensors.sensorList[index].type;
+  return true;
 }
 
-boolean updateSensorValue(const SensorAddress address, const float value) {
-   for (int i = 0; i < sensors.count; i++) {
-     if (strcmp(sensors.sensorList[i].address, address) == 0) {
-       sensors.sensorList[i].value = value;
-       return true; 
-     }
-   }
-   return false;
-}
-
-boolean getSensorType(const SensorAddress address, SensorType& type) {
-   for (int i = 0; i < sensors.count; i++) {
-     if (strcmp(sensors.sensorList[i].address, address) == 0) {
-       type = sensors.sensorList[i].type;
-       return true; 
-     }
-   }
-   return false;
-}
-
-boolean getSensorConfig(const SensorAddress address, SensorConfig &output) {
-  // Tacker durch das sensorConfig Array in config durch
-  for (int i = 0; i < sensorConfigCount; i++) {
-    // Vergleich die Adresse aus dem Parameter mit der in der Config
-    if (strcmp(address, config.sensorConfig[i].address) == 0) {
-      // Und schreib bei Übereinstimmung die config-Werte aus der globalen config in den Sensor
-      Serial.print("getSensorConfig(): Sensor gefunden: Adresse=");
-      Serial.println(address);
-      strcpy( output.name,        config.sensorConfig[i].config.name);
-      strcpy( output.format,      config.sensorConfig[i].config.format);
-              output.formatMin  = config.sensorConfig[i].config.formatMin;
-              output.formatMax  = config.sensorConfig[i].config.formatMax;
-              output.precision  = config.sensorConfig[i].config.precision;
-              output.min        = config.sensorConfig[i].config.min;
-              output.max        = config.sensorConfig[i].config.max;
+boolean getSensorConfig(const DeviceAddress deviceAddress, SensorConfig &output) {
+  DeviceAddress recordAddress;
+  int           length;
+
+  // Tacker durch die Einträge der Sensor-Konfig, jeder beginnt mit dem ROM-Code
+  for (int i = 0; i < configRecordCount; i++) {
+    if (isConfigAddressOf(&config.sensorRecords[configRecordOffsets[i]], deviceAddress)) {
+      // Und lies bei Übereinstimmung den ganzen Eintrag
+      getSensorRecord(config, configRecordOffsets[i], recordAddress, output, length);
+      Serial.print("getSensorConfig(): Sensor gefunden, Eintrag ");
+      Serial.println(i);
       return true;
     }
   }
   return false;
 }
 
-void removeSensor(SensorAddress address) {
-  for (int i = 0; i < sensors.count; i++) {
-    if (sensors.sensorList[i].address == address) {
-      // Sensor gefunden, löschen, indem die nachfolgenden Elemente verschoben werden
-      for (int j = i; j < sensors.count - 1; j++) {
-        sensors.sensorList[j] = sensors.sensorList[j + 1];
-      }
+void removeSensor(const SensorRom rom) {
+  int i = findSensorByRom(rom);
 
-      // Verringere die Anzahl der Sensoren
-      sensors.count--;
+  if (i < 0) {
+    initalClear = false;
+    return;
+  }
 
-      // Reduziere die Speichergröße
-      Sensor* tempArray = (Sensor*)malloc(sensors.count * sizeof(Sensor));
+  // Beende das Streaming dieses Sensors
+  if (streamState != STREAM_OFF && streamSensor == i) {
+    stopStream();
+  }
 
-      // Übertrage Daten in das temporäre Array
-      for (int k = 0; k < sensors.count; k++) {
-        tempArray[k] = sensors.sensorList[k];
-      }
+  // Gib den Treiber eines DS2438 frei
+  releaseDs2438(sensors.sensorList[i]);
 
-      // Befreie den alten Speicher
-      free(sensors.sensorList);
+  // Entferne den Sensor aus dem Index
+  unindexSensor(i);
 
-      // Weise den neuen Speicher zu
-      sensors.sensorList = tempArray;
+  // Gib den Platz frei, die übrigen Sensoren behalten ihren Index. Der geleerte Platz ist weder fällig noch gemeldet.
+  sensors.sensorList[i] = Sensor();
+  sensors.freeSlots[sensors.freeCount++] = i;
+  sensors.count--;
 
-      break;
-    }
-  }
+  // Nimm den Sensor aus der Planung
+  rebuildSchedule();
   initalClear = false;
 }
 
@@ -868,7 +1799,7 @@ boolean wifiFine() {
 }
 
 boolean sensorsFine() {
- return dallasSensors.getDeviceCount() > 0;
+ return sensors.count > 0;
 }
 
 void blink() {
@@ -885,184 +1816,1472 @@ void blink() {
   }
 }
 
-void updateLevels() {
-  // Brich ab, wenn unser Inverall noch nicht erreicht ist
-  if (millis() < levelCheckLast + (levelCheckInterval * 1000)) {
+ProfileResult getProbeProfileResult(DS2438 &probe, const boolean success) {
+  // Ein fehlgeschlagener Zugriff ohne Presence-Puls zählt nicht als CRC-Fehler
+  if (success) {
+    return PR_OK;
+  }
+  return probe.isPresent() ? PR_CRC_ERROR : PR_NO_PRESENCE;
+}
+
+boolean getLevelProbeValue(DS2438 &probe, const SensorChannels channels, const int channel, SensorRaw &raw) {
+  // Der erste konfigurierte Messwert wird zum Wert des Sensors, sofern er im Durchgang für channel gewandelt wurde.
+  // Spannungen bleiben in 10 mV (U_VOLTAGE), die Temperatur kommt in 1/32 °C und wird auf U_TEMPERATURE gebracht.
+  if (channels & DS2438_MODE_CHA) {
+    if (channel != DS2438_CHA) {
+      return false;
+    }
+    raw = probe.getVoltageRaw(DS2438_CHA);
+  } else if (channels & DS2438_MODE_CHB) {
+    if (channel != DS2438_CHB) {
+      return false;
+    }
+    raw = probe.getVoltageRaw(DS2438_CHB);
+  } else {
+    raw = probe.getTemperatureRaw() >> 1;
+  }
+  return true;
+}
+
+int getLevelPassChannel(const OneWireBus &bus, const int pass) {
+  // Die Reihenfolge der Kanäle wechselt mit jedem Zyklus. So beginnt ein Zyklus mit dem Kanal, der am Ende des 
+  // vorherigen eingestellt war, und Sonden, die beide Kanäle brauchen, müssen nur einmal pro Zyklus umschalten.
+  if ((bus.levelCycle + pass) % 2 == 0) {
+    return DS2438_CHA;
+  } else {
+    return DS2438_CHB;
+  }
+}
+
+boolean isLevelProbeInPass(const OneWireBus &bus, const Sensor &sensor, const int pass) {
+  SensorChannels channelMode = getLevelPassChannel(bus, pass) == DS2438_CHA ? DS2438_MODE_CHA : DS2438_MODE_CHB;
+
+  if (sensor.type != 'b' || !sensor.due || sensor.bus != bus.index || isStreaming(sensor)) {
+    return false;
+  }
+  if (sensor.config.channels & channelMode) {
+    return true;
+  }
+  // Reine Temperatur-Sonden werden im ersten Durchgang mit dem Kanal gelesen, der gerade eingestellt ist
+  return pass == 0 && !(sensor.config.channels & (DS2438_MODE_CHA | DS2438_MODE_CHB));
+}
+
+void prepareLevelProbe(Sensor &sensor, const int channel) {
+  boolean success;
+
+  // Reine Temperatur-Sonden brauchen keinen bestimmten Kanal
+  if (sensor.probe < 0 || !(sensor.config.channels & (DS2438_MODE_CHA | DS2438_MODE_CHB))) {
     return;
   }
-  Serial.println("updateLevels() begin");
-  levelCheckLast = millis();
+  // Der Treiber kennt den eingestellten Kanal, ein Bus-Zugriff erfolgt nur bei einem Wechsel
+  unsigned long start = busAccessStart(buses[sensor.bus]);
+  success = ds2438Pool[sensor.probe].driver.prepareChannel(channel);
+  profileEnd(start, P_SELECT_CHANNEL, sensor.deviceAddress, sensor.bus, getProbeProfileResult(ds2438Pool[sensor.probe].driver, success));
+  if (!success) {
+    Serial.print("  Sensor DS2438 ");
+    Serial.print(sensor.address);
+    Serial.println(": Kanal konnte nicht eingestellt werden");
+  }
+}
 
-  for (int i = 0; i < sensors.count; i++) {
-    if (sensors.sensorList[i].type == 'b') {
-      DS2438 ds2438(&oneWire, sensors.sensorList[i].deviceAddress);
-      ds2438.begin();
-      Serial.print("  Sensor DS2438 ");
-      Serial.print(sensors.sensorList[i].address);
-      Serial.print(" Adresse ");
-      Serial.print((unsigned int)&ds2438, HEX);
-      if (!dummySensors) {
-        ds2438.update();
-        if (ds2438.isError()) {
-          Serial.print(" erfolglos abgefragt"); 
-        } else {
-          Serial.print(" erfolgreich abgefragt");
-          updateSensorValue(sensors.sensorList[i].address, ds2438.getVoltage(DS2438_CHA));
+void readLevelProbe(Sensor &sensor, const int channel, const boolean doTemperature) {
+  SensorRaw raw;
+  boolean success;
+
+  if (sensor.probe < 0) {
+    return;
+  }
+  DS2438 &ds2438 = ds2438Pool[sensor.probe].driver;
+
+  Serial.print("  Sensor DS2438 ");
+  Serial.print(sensor.address);
+  success = false;
+  // Eine gestörte Übertragung wird sofort wiederholt, das Ergebnis der Wandlung bleibt im DS2438 erhalten
+  for (int attempt = 0; !success && attempt <= sensorReadRetries; attempt++) {
+    unsigned long start = busAccessStart(buses[sensor.bus]);
+    success = ds2438.readConversion(channel, doTemperature);
+    profileEnd(start, P_READ_PAGE, sensor.deviceAddress, sensor.bus, getProbeProfileResult(ds2438, success));
+  }
+  if (!success) {
+    sensor.status = ds2438.isPresent() ? S_CRC_ERROR : S_NO_PRESENCE;
+    Serial.print(" erfolglos abgefragt: ");
+    Serial.println(sensorStatusToStr(sensor.status));
+    return;
+  }
+  sensor.status = S_OK;
+  Serial.print(" erfolgreich abgefragt: Kanal ");
+  Serial.print(channel == DS2438_CHA ? "A" : "B");
+  Serial.print(" = ");
+  Serial.print(ds2438.getVoltageRaw(channel));
+  Serial.print("0 mV, Temperatur = ");
+  Serial.print(ds2438.getTemperatureRaw());
+  Serial.print("/32 C, Bus-Transaktionen = ");
+  Serial.print(ds2438.getTransactionCount());
+  Serial.print(", EEPROM-Schreibvorgänge = ");
+  Serial.println(ds2438.getCopyCount());
+  if (getLevelProbeValue(ds2438, sensor.config.channels, channel, raw)) {
+    sensor.raw = raw;
+  }
+}
+
+boolean nextLevelProbeInPass(OneWireBus &bus) {
+  // Suche ab bus.levelReadIndex den nächsten DS2438, der am aktuellen Durchgang teilnimmt
+  while (bus.levelReadIndex < sensors.slots && !isLevelProbeInPass(bus, sensors.sensorList[bus.levelReadIndex], bus.levelPass)) {
+    bus.levelReadIndex++;
+  }
+  return bus.levelReadIndex < sensors.slots;
 }
+
+void updateLevels(OneWireBus &bus) {
+  /* 
+    Die DS2438 werden gebündelt abgefragt, damit die Wandlungszeit nicht mit der Anzahl der Sonden wächst:
+    LEVEL_SELECT    => Pro Aufruf wird bei einem DS2438 der Kanal des Durchgangs eingestellt. Der Treiber in ds2438Pool 
+                       behält Seite 0 zwischen den Abfragen, ein Bus-Zugriff erfolgt daher nur bei einem Kanalwechsel.
+    LEVEL_CONVERT_T => Eine Temperatur-Wandlung per Skip-ROM an alle DS2438, dann einmal warten
+    LEVEL_CONVERT_V => Eine Spannungs-Wandlung per Skip-ROM an alle DS2438, dann einmal warten
+    LEVEL_READING   => Pro Aufruf wird ein DS2438 adressiert gelesen
+    Werden Kanal A und B benötigt, folgt ein zweiter Durchgang ab LEVEL_SELECT mit dem anderen Kanal.
+  */
+  unsigned long start;
+
+  // Bei parasitärer Versorgung darf der Bus während einer laufenden Temperatur-Wandlung nicht angesprochen werden
+  if ((bus.tempState == TEMP_CONVERTING || bus.tempState == TEMP_ALARM_SEARCH) && bus.parasite) {
+    return;
+  }
+
+  switch (bus.levelState) {
+    case LEVEL_IDLE:
+      // Brich ab, wenn noch kein DS2438 fällig ist
+      if (bus.levelSchedule.count == 0 || !isSensorDue(sensors.sensorList[bus.levelSchedule.entries[0]], millis())) {
+        return;
+      }
+      // Die Skip-ROM Temperatur-Wandlung würde auch eine laufende Wandlung der DS18B20 neu starten
+      // und während der Alarm-Suche deren Alarm-Flags verändern
+      if (bus.tempState == TEMP_CONVERTING || bus.tempState == TEMP_ALARM_SEARCH) {
+        return;
+      }
+      popDueSensors(bus.levelSchedule, millis());
+
+      // Dummy-Sensoren erhalten ihre Werte direkt
+      if (dummySensors) {
+        for (int i = 0; i < sensors.slots; i++) {
+          if (!sensors.sensorList[i].used) {
+            continue;
+          }
+          if (sensors.sensorList[i].type == 'b' && sensors.sensorList[i].due && sensors.sensorList[i].bus == bus.index) {
+            sensors.sensorList[i].raw = (random(0,2) + (1 / random(1,10))) * U_VOLTAGE;
+          }
+        }
+        rescheduleDueSensors(bus, 'b');
+        return;
+      }
+
+      // Ermittle, ob eine Temperatur benötigt wird
+      bus.levelCycle++;
+      bus.levelTemperature      = false;
+      bus.levelTemperatureDone  = false;
+      for (int i = 0; i < sensors.slots; i++) {
+        if (!sensors.sensorList[i].used) {
+          continue;
+        }
+        if (!sensors.sensorList[i].due || sensors.sensorList[i].type != 'b' || sensors.sensorList[i].bus != bus.index) {
+          continue;
+        }
+        if (sensors.sensorList[i].probe >= 0) {
+          ds2438Pool[sensors.sensorList[i].probe].driver.resetCounters();
+        }
+        if (sensors.sensorList[i].config.channels & DS2438_MODE_TEMPERATURE) {
+          bus.levelTemperature = true;
+        }
+      }
+
+      // Beginne mit dem ersten Durchgang, an dem ein fälliger DS2438 teilnimmt
+      bus.levelPass       = 0;
+      bus.levelReadIndex  = 0;
+      if (!nextLevelProbeInPass(bus)) {
+        bus.levelPass       = 1;
+        bus.levelReadIndex  = 0;
+      }
+      Serial.println("updateLevels() begin");
+      bus.levelReadIndex  = 0;
+      bus.levelState      = LEVEL_SELECT;
+      return;
+
+    case LEVEL_SELECT:
+      // Stelle bei einem DS2438 den Kanal des Durchgangs ein
+      if (nextLevelProbeInPass(bus)) {
+        prepareLevelProbe(sensors.sensorList[bus.levelReadIndex], getLevelPassChannel(bus, bus.levelPass));
+        bus.levelReadIndex++;
+        return;
+      }
+
+      // Alle Kanäle eingestellt, starte die Wandlung auf allen DS2438 gleichzeitig
+      bus.levelReadIndex = 0;
+      bus.levelPollIndex = 0;
+      bus.levelWaitStart = micros();
+      start = busAccessStart(bus);
+      if (bus.levelTemperature && !bus.levelTemperatureDone) {
+        DS2438::broadcastTemperatureConversion(&bus.oneWire);
+        profileEnd(start, P_CONVERT_T, nullptr, bus.index, PR_OK);
+        bus.levelTemperatureDone = true;
+        bus.levelWaitTime = DS2438_TEMPERATURE_DELAY * 1000UL;
+        bus.levelState    = LEVEL_CONVERT_T;
       } else {
-        updateSensorValue(sensors.sensorList[i].address, random(0,2) + (1 / random(1,10)));
+        DS2438::broadcastVoltageConversion(&bus.oneWire);
+        profileEnd(start, P_CONVERT_V, nullptr, bus.index, PR_OK);
+        bus.levelWaitTime = DS2438_VOLTAGE_CONVERSION_DELAY * 1000UL;
+        bus.levelState    = LEVEL_CONVERT_V;
+      }
+      return;
+
+    case LEVEL_CONVERT_T:
+      if (micros() - bus.levelWaitStart < bus.levelWaitTime && !levelConversionComplete(bus)) {
+        return;
+      }
+      bus.levelPollIndex  = 0;
+      bus.levelWaitStart  = micros();
+      start = busAccessStart(bus);
+      DS2438::broadcastVoltageConversion(&bus.oneWire);
+      profileEnd(start, P_CONVERT_V, nullptr, bus.index, PR_OK);
+      bus.levelWaitTime   = DS2438_VOLTAGE_CONVERSION_DELAY * 1000UL;
+      bus.levelState      = LEVEL_CONVERT_V;
+      return;
+
+    case LEVEL_CONVERT_V:
+      if (micros() - bus.levelWaitStart < bus.levelWaitTime && !levelConversionComplete(bus)) {
+        return;
+      }
+      bus.levelState = LEVEL_READING;
+      // Kein break, es kann direkt der erste DS2438 gelesen werden
+
+    case LEVEL_READING:
+      // Lies einen DS2438 des Durchgangs
+      if (nextLevelProbeInPass(bus)) {
+        readLevelProbe(sensors.sensorList[bus.levelReadIndex], getLevelPassChannel(bus, bus.levelPass), bus.levelTemperatureDone && sensors.sensorList[bus.levelReadIndex].config.channels & DS2438_MODE_TEMPERATURE);
+        bus.levelReadIndex++;
+        return;
+      }
+
+      // Durchgang beendet, ggf. folgt der zweite Kanal
+      bus.levelReadIndex = 0;
+      if (bus.levelPass == 0) {
+        bus.levelPass = 1;
+        if (nextLevelProbeInPass(bus)) {
+          bus.levelState = LEVEL_SELECT;
+          return;
         }
-        Serial.print(": Timestamp: ");
-        Serial.print(ds2438.getTimestamp());
-        Serial.print(": Temperatur = ");
-        Serial.print(ds2438.getTemperature(), 1);
-        Serial.print("C, Kanal A = ");
-        Serial.print(ds2438.getVoltage(DS2438_CHA), 1); // Pin 1
-        Serial.print("v, Kanal B = ");
-        Serial.print(ds2438.getVoltage(DS2438_CHB), 1);
-        Serial.println("v.");
-            //delete &ds2438;  // MR: Keine Ahnung warum, aber das führt zu nem Freeze
-    }
+      }
+      rescheduleDueSensors(bus, 'b');
+      bus.levelState = LEVEL_IDLE;
+      Serial.println("updateLevels() end");
+      return;
   }
-  Serial.println("updateLevels() end");
 }
 
-void updateTemperatures() {
-  // Brich ab, wenn unser Inverall noch nicht erreicht ist
-  if (millis() < tempCheckLast + (tempCheckInterval * 1000)) {
+boolean isSensorDue(const Sensor &sensor, const unsigned long now) {
+  // Vergleich über die Differenz, damit der Überlauf von millis() nach ca. 49 Tagen keine Rolle spielt
+  return (long)(now - sensor.nextDue) >= 0;
+}
+
+boolean isScheduledBefore(const int a, const int b) {
+  return (long)(sensors.sensorList[a].nextDue - sensors.sensorList[b].nextDue) < 0;
+}
+
+void scheduleSensor(SensorSchedule &schedule, const int index) {
+  // Füge den Sensor in den Min-Heap ein und lass ihn nach oben steigen, bis sein Vorgänger früher fällig ist
+  int pos = schedule.count;
+  if (schedule.count >= sensorScheduleSize) {
+    Serial.println("scheduleSensor(): Planung voll, sensorScheduleSize erhöhen");
     return;
   }
-  Serial.println("updateTemperatures() begin");
-  tempCheckLast = millis();
+  schedule.count++;
+  while (pos > 0 && isScheduledBefore(index, schedule.entries[(pos - 1) / 2])) {
+    schedule.entries[pos] = schedule.entries[(pos - 1) / 2];
+    pos = (pos - 1) / 2;
+  }
+  schedule.entries[pos] = index;
+}
 
-  // Aktualisiere die Temperaturdaten
-  Serial.println("  Aktualisiere Temperaturen");
-  dallasSensors.requestTemperatures();
+int popSchedule(SensorSchedule &schedule) {
+  // Entnimm die Wurzel und lass das letzte Element von oben nach unten sinken
+  int top   = schedule.entries[0];
+  int last  = schedule.entries[--schedule.count];
+  int pos   = 0;
+  int child;
+  while ((child = 2 * pos + 1) < schedule.count) {
+    if (child + 1 < schedule.count && isScheduledBefore(schedule.entries[child + 1], schedule.entries[child])) {
+      child++;
+    }
+    if (!isScheduledBefore(schedule.entries[child], last)) {
+      break;
+    }
+    schedule.entries[pos] = schedule.entries[child];
+    pos = child;
+  }
+  schedule.entries[pos] = last;
+  return top;
+}
 
-  // Iteriere durch alle Sensoren
-  for (int i = 0; i < sensors.count; i++) {
-    if (sensors.sensorList[i].type == 't') {
-      // Aktualisiere die Liste
-      if (!dummySensors) {
-        updateSensorValue(sensors.sensorList[i].address, dallasSensors.getTempC(sensors.sensorList[i].deviceAddress));
+int popDueSensors(SensorSchedule &schedule, const unsigned long now) {
+  // Markiere alle fälligen Sensoren für die anstehende Abfrage, die Wurzel des Heaps ist immer der nächste fällige
+  int count = 0;
+  while (schedule.count > 0 && isSensorDue(sensors.sensorList[schedule.entries[0]], now)) {
+    sensors.sensorList[popSchedule(schedule)].due = true;
+    count++;
+  }
+  return count;
+}
+
+void rescheduleDueSensors(OneWireBus &bus, const char type) {
+  /*
+    Plane alle Sensoren der abgeschlossenen Abfrage neu ein. Hat sich der Wert seit der letzten Abfrage deutlich 
+    geändert, wird das Intervall halbiert, sonst um ein Viertel verlängert, jeweils in den Grenzen von *IntervalMin 
+    und *IntervalMax. So wird Bus-Zeit dort verbraucht, wo sich die Werte auch bewegen.
+    Schlägt die Abfrage fehl, verdoppelt sich das Intervall bis sensorBackoffMax. Nach sensorQuarantineLimit 
+    Fehlschlägen in Folge kommt der Sensor in Quarantäne und wird nur noch alle sensorQuarantineInterval geprüft.
+  */
+  unsigned long intervalMin = (type == 't' ? tempIntervalMin      : levelIntervalMin) * 1000UL;
+  unsigned long intervalMax = (type == 't' ? tempIntervalMax      : levelIntervalMax) * 1000UL;
+  SensorSchedule &schedule  =  type == 't' ? bus.tempSchedule     : bus.levelSchedule;
+
+  for (int i = 0; i < sensors.slots; i++) {
+
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    Sensor &sensor = sensors.sensorList[i];
+    if (!sensor.due || sensor.type != type || sensor.bus != bus.index) {
+      continue;
+    }
+    // Ein DS18B20 mit Alarm-Band und gültigem Wert wird ab jetzt nur noch per Alarm-Suche überwacht
+    if (type == 't' && !dummySensors) {
+      sensor.alarmArmed = sensor.status == S_OK && hasAlarmBand(sensor.config);
+    }
+    if (sensor.status != S_OK) {
+      // Exponentielles Backoff: Jeder weitere Fehlschlag verdoppelt das Intervall, bis der Sensor in Quarantäne kommt
+      if (sensor.failures < 255) {
+        sensor.failures++;
+      }
+      if (sensor.failures >= sensorQuarantineLimit) {
+        if (sensor.health != H_QUARANTINED) {
+          Serial.print("  Sensor ");
+          Serial.print(sensor.address);
+          Serial.println(" in Quarantäne");
+        }
+        sensor.health   = H_QUARANTINED;
+        sensor.interval = sensorQuarantineInterval * 1000UL;
       } else {
-        updateSensorValue(sensors.sensorList[i].address, random(15,25));
+        sensor.health   = H_DEGRADED;
+        sensor.interval = min(sensorBackoffMax * 1000UL, sensor.interval * 2);
       }
+    } else if (sensor.health != H_OK) {
+      // Der Sensor hat sich erholt, beginne wieder mit dem Anfangs-Intervall
+      Serial.print("  Sensor ");
+      Serial.print(sensor.address);
+      Serial.println(" wieder ok");
+      sensor.health     = H_OK;
+      sensor.failures   = 0;
+      sensor.interval   = (type == 't' ? tempCheckInterval : levelCheckInterval) * 1000UL;
+      sensor.lastRaw    = sensor.raw;
+    } else if (sensor.alarmArmed) {
+      // Die Alarm-Suche läuft bei jeder Wandlung, das Intervall bestimmt nur, wie oft der Sensor selbst eine auslöst
+      sensor.interval = tempCheckInterval * 1000UL;
+    } else {
+      if (abs(sensor.raw - sensor.lastRaw) >= (sensor.unit == U_TEMPERATURE ? tempChangeThreshold : levelChangeThreshold)) {
+        sensor.interval = max(intervalMin, sensor.interval / 2);
+      } else {
+        sensor.interval = min(intervalMax, sensor.interval + sensor.interval / 4);
+      }
+      sensor.lastRaw = sensor.raw;
     }
+    sensor.nextDue  = millis() + sensor.interval;
+    sensor.due      = false;
+    scheduleSensor(schedule, i);
   }
-  Serial.println("updateTemperatures() end");
 }
 
-void setup1Wire() {
-  byte              addrArray[8];
-  String            address;
+void initSensorSchedule(const int index) {
+  // Plane den Sensor mit dem Anfangs-Intervall seiner Art zur sofortigen Abfrage ein
+  Sensor &sensor = sensors.sensorList[index];
+  sensor.nextDue    = millis();
+  sensor.due        = false;
+  sensor.lastRaw    = sensor.raw;
+  if (sensor.type == 't') {
+    sensor.interval = tempCheckInterval * 1000UL;
+    scheduleSensor(buses[sensor.bus].tempSchedule, index);
+  } else if (sensor.type == 'b') {
+    sensor.interval = levelCheckInterval * 1000UL;
+    scheduleSensor(buses[sensor.bus].levelSchedule, index);
+  }
+}
+
+void rebuildSchedule() {
+  // Baue die Heaps neu auf, Intervalle und Fälligkeiten der Sensoren bleiben erhalten
+  for (int b = 0; b < oneWireBusCount; b++) {
+    buses[b].tempSchedule.count   = 0;
+    buses[b].levelSchedule.count  = 0;
+  }
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    sensors.sensorList[i].due = false;
+    if (sensors.sensorList[i].type == 't') {
+      scheduleSensor(buses[sensors.sensorList[i].bus].tempSchedule, i);
+    } else if (sensors.sensorList[i].type == 'b') {
+      scheduleSensor(buses[sensors.sensorList[i].bus].levelSchedule, i);
+    }
+  }
+}
+
+void setupSchedule() {
+  for (int b = 0; b < oneWireBusCount; b++) {
+    buses[b].tempSchedule.count   = 0;
+    buses[b].levelSchedule.count  = 0;
+  }
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    initSensorSchedule(i);
+  }
+}
+
+unsigned long busAccessStart(OneWireBus &bus) {
+  // Jeder Bus-Zugriff beginnt hier: Er zählt für busConversionComplete() und startet die Zeitmessung des Profilers
+  bus.activity++;
+  return profileStart();
+}
+
+boolean busConversionComplete(OneWireBus &bus, const unsigned long mark) {
+  /*
+    Extern versorgte DS18B20 antworten während einer Wandlung auf Lese-Slots mit 0 und danach mit 1. Bei mehreren 
+    Sensoren ergibt sich erst eine 1, wenn alle fertig sind. So kann meist deutlich vor Ablauf der Worst-Case-
+    Wandlungszeit gelesen werden. DS2438 melden sich so nicht, siehe levelConversionComplete().
+    Das gilt nicht bei parasitärer Versorgung (der Bus muss dann durchgehend High gehalten werden) und nicht, wenn seit 
+    dem Start der Wandlung (mark) ein anderer Bus-Zugriff stattgefunden hat. Dann bleibt es bei der festen Wartezeit.
+  */
+  if (bus.parasite || bus.activity != mark) {
+    return false;
+  }
+  return bus.oneWire.read_bit() == 1;
+}
+
+boolean levelConversionComplete(OneWireBus &bus) {
+  /*
+    Ein DS2438 meldet eine laufende Wandlung über TB bzw. ADB in seinem Status-Register. Pro Aufruf wird ein DS2438 
+    des Durchgangs adressiert gefragt, fertig ist die Wandlung, wenn keiner mehr wandelt. Bei parasitärer Versorgung 
+    bleibt es bei der festen Wartezeit, ebenso wenn ein DS2438 nicht gelesen werden kann.
+  */
+  boolean busy;
+  boolean success;
+
+  if (bus.parasite) {
+    return false;
+  }
+  while (bus.levelPollIndex < sensors.slots && !isLevelProbeInPass(bus, sensors.sensorList[bus.levelPollIndex], bus.levelPass)) {
+    bus.levelPollIndex++;
+  }
+  if (bus.levelPollIndex >= sensors.slots) {
+    return true;
+  }
+  Sensor &sensor = sensors.sensorList[bus.levelPollIndex];
+  if (sensor.probe < 0) {
+    bus.levelPollIndex++;
+    return false;
+  }
+  unsigned long start = busAccessStart(bus);
+  success = ds2438Pool[sensor.probe].driver.readBusy(busy);
+  profileEnd(start, P_READ_PAGE, sensor.deviceAddress, bus.index, getProbeProfileResult(ds2438Pool[sensor.probe].driver, success));
+  if (success && !busy) {
+    bus.levelPollIndex++;
+  }
+  return false;
+}
+
+int getConversionResolution(const Sensor &sensor) {
+  // Der DS18S20 hat eine feste Auflösung und braucht immer die volle Wandlungszeit
+  if (sensor.deviceAddress[0] == DS18S20MODEL) {
+    return 12;
+  }
+  return sensor.config.resolution;
+}
+
+boolean nextTemperatureSensor(OneWireBus &bus) {
+  // Suche ab bus.tempReadResolution/bus.tempReadIndex den nächsten DS18B20, aufsteigend nach Auflösung und damit Wandlungszeit
+  while (bus.tempReadResolution <= 12) {
+    while (bus.tempReadIndex < sensors.slots) {
+      if (sensors.sensorList[bus.tempReadIndex].type == 't' && isTemperatureSensorInPhase(bus, sensors.sensorList[bus.tempReadIndex]) && getConversionResolution(sensors.sensorList[bus.tempReadIndex]) == bus.tempReadResolution) {
+        return true;
+      }
+      bus.tempReadIndex++;
+    }
+    bus.tempReadResolution++;
+    bus.tempReadIndex = 0;
+  }
+  return false;
+}
+
+boolean isTemperatureSensorInPhase(const OneWireBus &bus, const Sensor &sensor) {
+  // Erst werden die fälligen Sensoren ohne Alarm-Band gelesen, danach nur die, die die Alarm-Suche gemeldet hat
+  if (sensor.bus != bus.index) {
+    return false;
+  }
+  if (bus.tempAlarmPhase) {
+    return sensor.alarmHit;
+  }
+  return sensor.due && !sensor.alarmArmed;
+}
+
+void finishTemperatureReads(OneWireBus &bus) {
+  // Gibt es Sensoren mit Alarm-Band, folgt auf das Lesen die Alarm-Suche, sonst ist die Abfrage beendet
+  if (!bus.tempAlarmPhase && bus.tempAlarmResolution > 0) {
+    bus.dallasSensors.resetAlarmSearch();
+    bus.tempState = TEMP_ALARM_SEARCH;
+    return;
+  }
+  rescheduleDueSensors(bus, 't');
+  bus.tempState = TEMP_IDLE;
+}
+
+SensorStatus readTemperatureScratchPad(OneWireBus &bus, const DeviceAddress deviceAddress, int16_t &raw) {
+  // Ein einziger Bus-Zugriff pro Sensor: Scratchpad lesen, Prüfsumme prüfen und direkt dekodieren. 
+  // getTempC() würde vorher per isConnected() ein zweites Mal lesen und Fehler nur als -127 melden.
+  ScratchPad    scratchPad;
+  SensorStatus  status;
+  unsigned long start = busAccessStart(bus);
+
+  if (!bus.dallasSensors.readScratchPad(deviceAddress, scratchPad)) {
+    status = S_NO_PRESENCE;
+  } else {
+    status = decodeTemperatureScratchPad(deviceAddress[0], scratchPad, raw);
+  }
+  profileEnd(start, P_READ_SCRATCHPAD, deviceAddress, bus.index, status == S_NO_PRESENCE ? PR_NO_PRESENCE : (status == S_CRC_ERROR || status == S_BUS_ERROR) ? PR_CRC_ERROR : PR_OK);
+  return status;
+}
+
+void readTemperatureSensor(Sensor &sensor) {
+  int16_t raw;
+
+  if (dummySensors) {
+    sensor.raw = random(15,25) * U_TEMPERATURE;
+    return;
+  }
+
+  sensor.status = readTemperatureScratchPad(buses[sensor.bus], sensor.deviceAddress, raw);
+  // Übertragungsfehler werden sofort wiederholt. Beim Einschaltwert hat keine Wandlung stattgefunden, 
+  // eine Wiederholung würde nur denselben Wert liefern.
+  for (int attempt = 0; sensor.status != S_OK && sensor.status != S_POWER_ON_VALUE && attempt < sensorReadRetries; attempt++) {
+    sensor.status = readTemperatureScratchPad(buses[sensor.bus], sensor.deviceAddress, raw);
+  }
+  if (sensor.status == S_OK) {
+    sensor.raw = raw;
+  } else {
+    // Der letzte gültige Wert bleibt erhalten, ohne gültigen Wert wird der Sensor wieder bei jeder Fälligkeit gelesen
+    sensor.alarmArmed = false;
+    Serial.print("  Sensor DS18B20 ");
+    Serial.print(sensor.address);
+    Serial.print(" erfolglos abgefragt: ");
+    Serial.println(sensorStatusToStr(sensor.status));
+  }
+}
+
+void updateTemperatures(OneWireBus &bus) {
+  /* 
+    Die Abfrage läuft als Zustandsautomat über mehrere loop()-Durchläufe, damit loop() nicht für die gesamte Wandlungszeit
+    (bis zu 750 ms bei 12 Bit) blockiert:
+    TEMP_IDLE       => Wandlung auf allen Sensoren starten und sofort zurückkehren
+    TEMP_CONVERTING => Jeder Sensor wird gelesen, sobald die Wandlungszeit seiner eigenen Auflösung abgelaufen ist,
+                       ein 9-Bit-Sensor also bereits nach 94 ms, auch wenn andere Sensoren mit 12 Bit noch wandeln.
+                       Bei parasitärer Versorgung würde das Lesen den Strong Pull-Up der noch wandelnden Sensoren 
+                       beenden, dort wird die Wandlungszeit des langsamsten Sensors abgewartet.
+    TEMP_READING    => Die Sensoren haben das Ende der Wandlung gemeldet, alle restlichen werden ohne weitere Wartezeit gelesen
+    TEMP_ALARM_SEARCH => Sensoren mit Alarm-Band (alarmArmed) werden nicht direkt gelesen. Da die Wandlung per Skip ROM
+                       alle Sensoren erfasst, hat jeder von ihnen seine Alarm-Flag aktualisiert. Die Alarm-Suche (0xEC)
+                       meldet nur die Sensoren außerhalb ihres Bandes, nur diese werden danach gelesen. Im Normalbetrieb
+                       kostet die Überwachung so eine einzige, ergebnislose Suche, egal wie viele Sensoren überwacht werden.
+    Pro Aufruf wird höchstens ein Sensor gelesen bzw. gesucht, damit auch ein großer Bus nur wenige ms pro Durchlauf kostet.
+  */
+  DeviceAddress deviceAddress;
+  int           index;
+  boolean       found;
+  boolean       addressed;
+  int           converting  = 0;
+  int           total       = 0;
+  unsigned long start;
+
+  switch (bus.tempState) {
+    case TEMP_IDLE:
+      // Brich ab, wenn noch kein Sensor fällig ist
+      if (bus.tempSchedule.count == 0 || !isSensorDue(sensors.sensorList[bus.tempSchedule.entries[0]], millis())) {
+        return;
+      }
+      // Ein Skip-ROM 0x44 oder auch nur ein Reset würde eine laufende Wandlung der DS2438 stören und parasitär den 
+      // Strong Pull-Up abbrechen. Die Abfrage der Tanksonden wird daher erst abgeschlossen, siehe LEVEL_IDLE.
+      if (bus.levelState != LEVEL_IDLE) {
+        return;
+      }
+      Serial.println("updateTemperatures() begin");
+      popDueSensors(bus.tempSchedule, millis());
+
+      // Ermittle, ob und nach welcher Wandlungszeit eine Alarm-Suche nötig ist und wie lange der langsamste Sensor wandelt
+      bus.tempAlarmResolution = 0;
+      bus.tempWaitResolution  = 9;
+      for (int i = 0; i < sensors.slots; i++) {
+        if (!sensors.sensorList[i].used) {
+          continue;
+        }
+        if (sensors.sensorList[i].bus != bus.index) {
+          continue;
+        }
+        sensors.sensorList[i].alarmHit = false;
+        if (sensors.sensorList[i].type != 't') {
+          continue;
+        }
+        if (sensors.sensorList[i].alarmArmed) {
+          bus.tempAlarmResolution = max(bus.tempAlarmResolution, getConversionResolution(sensors.sensorList[i]));
+        }
+        if (sensors.sensorList[i].alarmArmed || sensors.sensorList[i].due) {
+          bus.tempWaitResolution = max(bus.tempWaitResolution, getConversionResolution(sensors.sensorList[i]));
+          converting++;
+        }
+        total++;
+      }
+      bus.tempAlarmPhase = false;
+
+      // Starte die Wandlung, ohne auf deren Ende zu warten. Nicht per requestTemperatures(), da DallasTemperature 
+      // die Versorgung nur in begin() ermittelt, das beim Warmstart entfällt. Bei parasitärer Versorgung hält write() 
+      // den Bus danach aktiv High.
+      // Sind nur wenige Sensoren fällig, werden nur diese per Match ROM gewandelt, die übrigen Sensoren und 
+      // die DS2438 bleiben in Ruhe. Parasitär höchstens einer, das nächste Reset würde den Strong Pull-Up beenden.
+      Serial.println("  Starte Wandlung");
+      addressed = converting < total && converting <= (bus.parasite ? 1 : tempMatchConvertLimit);
+      if (!dummySensors) {
+        start = busAccessStart(bus);
+        if (addressed) {
+          for (int i = 0; i < sensors.slots; i++) {
+            Sensor &sensor = sensors.sensorList[i];
+            if (sensor.used && sensor.bus == bus.index && sensor.type == 't' && (sensor.alarmArmed || sensor.due)) {
+              bus.oneWire.reset();
+              bus.oneWire.select(sensor.deviceAddress);
+              bus.oneWire.write(0x44, bus.parasite);
+              profileEnd(start, P_CONVERT_T, sensor.deviceAddress, bus.index, PR_OK);
+              start = profileStart();
+            }
+          }
+        } else {
+          bus.oneWire.reset();
+          bus.oneWire.skip();
+          bus.oneWire.write(0x44, bus.parasite);
+          profileEnd(start, P_CONVERT_T, nullptr, bus.index, PR_OK);
+        }
+      }
+      // Nach mehreren gezielten Wandlungen antwortet nur noch der zuletzt adressierte Sensor auf Lese-Slots, 
+      // dann entscheiden allein die Wandlungszeiten
+      bus.tempPollMark        = addressed && converting > 1 ? bus.activity - 1 : bus.activity;
+      bus.tempConvertStart    = millis();
+      bus.tempReadResolution  = 9;
+      bus.tempReadIndex       = 0;
+      bus.tempState           = TEMP_CONVERTING;
+      Serial.println("updateTemperatures() end");
+      return;
+
+    case TEMP_CONVERTING:
+      // Bei parasitärer Versorgung erst lesen, wenn auch der langsamste Sensor fertig ist. Sonst wird gestaffelt 
+      // gelesen, bis die Sensoren das Ende der Wandlung melden, danach können alle restlichen direkt gelesen werden.
+      if (bus.parasite && !dummySensors) {
+        if (millis() - bus.tempConvertStart < bus.dallasSensors.millisToWaitForConversion(bus.tempWaitResolution)) {
+          return;
+        }
+      } else if (dummySensors || !busConversionComplete(bus, bus.tempPollMark)) {
+        if (!nextTemperatureSensor(bus)) {
+          finishTemperatureReads(bus);
+          return;
+        }
+        // Warte, bis die Wandlungszeit für die Auflösung des nächsten Sensors abgelaufen ist
+        if (millis() - bus.tempConvertStart < bus.dallasSensors.millisToWaitForConversion(bus.tempReadResolution)) {
+          return;
+        }
+        readTemperatureSensor(sensors.sensorList[bus.tempReadIndex]);
+        bus.tempReadIndex++;
+        return;
+      }
+      bus.tempState = TEMP_READING;
+      // Kein break, es kann direkt der nächste Sensor gelesen werden
+
+    case TEMP_READING:
+      // Alle Sensoren gelesen, neu einplanen und zurück in den Ruhezustand
+      if (!nextTemperatureSensor(bus)) {
+        finishTemperatureReads(bus);
+        return;
+      }
+      readTemperatureSensor(sensors.sensorList[bus.tempReadIndex]);
+      bus.tempReadIndex++;
+      return;
+
+    case TEMP_ALARM_SEARCH:
+      // Die Alarm-Flags sind erst gültig, wenn auch der langsamste überwachte Sensor seine Wandlung beendet hat
+      if (millis() - bus.tempConvertStart < bus.dallasSensors.millisToWaitForConversion(bus.tempAlarmResolution)) {
+        return;
+      }
+      start = busAccessStart(bus);
+      found = bus.dallasSensors.alarmSearch(deviceAddress);
+      profileEnd(start, P_ALARM_SEARCH, nullptr, bus.index, PR_OK);
+      if (found) {
+        index = findSensor(deviceAddress);
+        if (index >= 0 && sensors.sensorList[index].bus == bus.index && sensors.sensorList[index].alarmArmed) {
+          Serial.print("  Alarm von Sensor ");
+          Serial.println(sensors.sensorList[index].address);
+          sensors.sensorList[index].alarmHit = true;
+        }
+        return;
+      }
+      // Suche beendet, lies die gemeldeten Sensoren
+      bus.tempAlarmPhase      = true;
+      bus.tempReadResolution  = 9;
+      bus.tempReadIndex       = 0;
+      bus.tempState           = TEMP_READING;
+      return;
+  }
+}
+
+int findSensor(const DeviceAddress deviceAddress) {
+  return findSensorByRom(deviceAddressToRom(deviceAddress));
+}
+
+boolean writeTemperatureRegisters(OneWireBus &bus, const DeviceAddress deviceAddress, const SensorResolution resolution, const SensorAlarm alarmLow, const SensorAlarm alarmHigh) {
+  /*
+    Schreibt TH, TL und die Auflösung eines DS18B20 in einem Zug ins Scratchpad und per Copy Scratchpad ins EEPROM, 
+    aber nur, wenn das Scratchpad abweicht. Nicht per setResolution()/setLowAlarmTemp()/setHighAlarmTemp(): Diese 
+    kennen die Versorgung nur aus begin(), das beim Warmstart entfällt, und kopierten parasitär dann ohne Strong 
+    Pull-Up. Außerdem beschreibt jeder dieser Aufrufe das EEPROM einzeln. bus.parasite gilt dagegen auch beim Warmstart.
+  */
+  ScratchPad  scratchPad;
+  uint8_t     configuration = ((resolution - 9) << 5) | 0x1F;
+
+  busAccessStart(bus);
+  if (bus.dallasSensors.readScratchPad(deviceAddress, scratchPad) && OneWire::crc8(scratchPad, 8) == scratchPad[8] &&
+      (SensorAlarm)scratchPad[2] == alarmHigh && (SensorAlarm)scratchPad[3] == alarmLow &&
+      (deviceAddress[0] == DS18S20MODEL || scratchPad[4] == configuration)) {
+    return true;
+  }
+
+  // Write Scratchpad, der DS18S20 hat kein Konfigurations-Register
+  if (!bus.oneWire.reset()) {
+    return false;
+  }
+  bus.oneWire.select(deviceAddress);
+  bus.oneWire.write(0x4E);
+  bus.oneWire.write((uint8_t)alarmHigh);
+  bus.oneWire.write((uint8_t)alarmLow);
+  if (deviceAddress[0] != DS18S20MODEL) {
+    bus.oneWire.write(configuration);
+  }
+
+  // Copy Scratchpad, parasitär hält der Strong Pull-Up den Sensor während des Schreibens ins EEPROM (max. 10 ms)
+  bus.oneWire.reset();
+  bus.oneWire.select(deviceAddress);
+  bus.oneWire.write(0x48, bus.parasite);
+  delay(20);
+  if (bus.parasite) {
+    bus.oneWire.depower();
+  }
+  return true;
+}
+
+int registerSensor(OneWireBus &bus, const DeviceAddress deviceAddress, const TopologyEntry *cached) {
+  // Erzeugt aus einer Geräte-Adresse einen Sensor samt Typ und Konfig und fügt ihn der Liste hinzu.
+  // Mit einem Eintrag aus dem Cache (Warmstart) werden die Register des DS18B20 nur beschrieben, wenn die Konfig abweicht.
   Sensor            sensor;
   SensorConfig      tempConfig;
+  int               index;
+
+  // Ermittle die Adresse und den Bus. Der Hex-String dient nur noch der Anzeige, gesucht wird per ROM-Code.
+  copyDeviceAddress(deviceAddress, sensor.deviceAddress);
+  sensor.bus = bus.index;
+  deviceAddressToHex(sensor.deviceAddress, sensor.address);
+  Serial.print("  address: ");
+  Serial.println(sensor.address);
+  
+  // Ermittle den Typ
+  if (cached != nullptr) {
+    sensor.type = (SensorType)cached->type;
+    Serial.println("  Typ aus dem Cache übernommen");
+  } else if (getSensorTypeByFamily(sensor.deviceAddress[0], sensor.type) == true) {
+    Serial.println("  Typ erfolgreich ermittelt");
+  } else {
+    Serial.println("  Typ nicht erfolgreich ermittelt");
+  }
+  Serial.print("  Typ: ");
+  Serial.println((int)sensor.type);
+
+  // Ermittle die Konfig
+  if (getSensorConfig(sensor.deviceAddress, tempConfig) == true) {
+    Serial.println("  Config erfolgreich ermittelt");
+    strcpy( sensor.config.name,         tempConfig.name);
+    strcpy( sensor.config.format,       tempConfig.format);
+            sensor.config.formatMin   = tempConfig.formatMin;
+            sensor.config.formatMax   = tempConfig.formatMax;
+            sensor.config.precision   = tempConfig.precision;
+            sensor.config.min         = tempConfig.min;
+            sensor.config.max         = tempConfig.max;
+            sensor.config.channels    = tempConfig.channels;
+            sensor.config.resolution  = tempConfig.resolution;
+            sensor.config.alarmLow    = tempConfig.alarmLow;
+            sensor.config.alarmHigh   = tempConfig.alarmHigh;
+  } else {
+    Serial.println("  Config nicht erfolgreich ermittelt");
+  }
 
-  Serial.println("setup1Wire() begin");
+  // Übertrage die konfigurierte Auflösung in das Konfigurations-Register des DS18B20
+  if (sensor.type == 't') {
+    // Ungültige Werte (z.B. aus einer älteren Konfig) führen zur Standard-Auflösung von 12 Bit
+    if (sensor.config.resolution < 9 || sensor.config.resolution > 12) {
+      sensor.config.resolution = 12;
+    }
 
-  // Initialisiere die OneWire- und DallasTemperature-Bibliotheken
-  if (oneWire.search(addrArray)) {
-  } else {
-    tft.println("Keine Geräte gefunden");
-    Serial.println("  Keine Geräte gefunden");
+    // Übertrage die Alarm-Schwellen nach TL/TH, ohne gültiges Band so, dass der Sensor nie Alarm meldet.
+    if (!hasAlarmBand(sensor.config)) {
+      sensor.config.alarmLow  = sensorAlarmLowOff;
+      sensor.config.alarmHigh = sensorAlarmHighOff;
+    }
+    if (cached != nullptr && cached->resolution == sensor.config.resolution && cached->alarmLow == sensor.config.alarmLow && cached->alarmHigh == sensor.config.alarmHigh) {
+      Serial.println("  Register laut Cache bereits gesetzt");
+    } else if (!writeTemperatureRegisters(bus, sensor.deviceAddress, sensor.config.resolution, sensor.config.alarmLow, sensor.config.alarmHigh)) {
+      Serial.println("  Register konnten nicht gesetzt werden");
+    }
+  }
+
+  // Binde einen dauerhaften Treiber an jeden DS2438
+  if (sensor.type == 'b') {
+    bindDs2438(sensor);
+  }
+
+  // Füg den Sensor der Liste hinzu, ist sie voll, wird der Treiber wieder frei
+  index = addSensor(sensor);
+  if (index < 0) {
+    releaseDs2438(sensor);
+  }
+  return index;
+}
+
+void startDiscovery(OneWireBus &bus) {
+  // Beginnt einen Suchlauf, updateDiscovery() führt ihn schrittweise durch
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    if (sensors.sensorList[i].bus == bus.index && sensors.sensorList[i].type != T_VIRTUAL) {
+      sensors.sensorList[i].seen = false;
+    }
+  }
+  bus.oneWire.reset_search();
+  bus.discoveryFound = 0;
+  bus.discoveryState = DISCOVERY_SEARCHING;
+}
+
+void updateDiscovery(OneWireBus &bus) {
+  /*
+    Durchsucht den Bus im Hintergrund nach neu angeschlossenen und entfernten Sensoren, ohne /reboot.
+    Pro Aufruf wird per oneWire.search() genau ein Gerät ermittelt (ca. 13 ms), die Suche wird beim nächsten Aufruf 
+    fortgesetzt. Ein Schritt erfolgt nur, wenn beide Abfragen ruhen und kein Sensor fällig ist, damit keine 
+    geplante Wandlung verzögert wird.
+    Neue Geräte werden per registerSensor() aufgenommen und eingeplant, Geräte, die discoveryMissLimit Suchläufe in 
+    Folge fehlen, per removeSensor() entfernt.
+  */
+  DeviceAddress deviceAddress;
+  int           index;
+  boolean       found;
+  boolean       changed = false;
+  SensorType    type;
+  unsigned long start;
+
+  if (dummySensors) {
+    return;
+  }
+
+  if (bus.discoveryState == DISCOVERY_IDLE) {
+    // Brich ab, wenn unser Inverall noch nicht erreicht ist
+    if (millis() < bus.discoveryLast + (discoveryInterval * 1000)) {
+      return;
+    }
+    startDiscovery(bus);
+  }
+
+  // Lass den laufenden und anstehenden Abfragen den Vortritt
+  if (bus.tempState != TEMP_IDLE || bus.levelState != LEVEL_IDLE) {
+    return;
+  }
+  if ((bus.tempSchedule.count > 0 && isSensorDue(sensors.sensorList[bus.tempSchedule.entries[0]], millis())) ||
+      (bus.levelSchedule.count > 0 && isSensorDue(sensors.sensorList[bus.levelSchedule.entries[0]], millis()))) {
+    return;
+  }
+
+  start = busAccessStart(bus);
+  found = bus.oneWire.search(deviceAddress);
+  if (found) {
+    // Verwirf Adressen mit falscher Prüfsumme, z.B. nach einer Störung während der Suche
+    if (OneWire::crc8(deviceAddress, 7) != deviceAddress[7]) {
+      profileEnd(start, P_SEARCH, nullptr, bus.index, PR_CRC_ERROR);
+      return;
+    }
+    profileEnd(start, P_SEARCH, nullptr, bus.index, PR_OK);
+    bus.discoveryFound++;
+    index = findSensor(deviceAddress);
+    // Wurde ein Sensor an einen anderen Bus umgesteckt, wird er dort erst entfernt und danach hier neu aufgenommen
+    if (index >= 0 && sensors.sensorList[index].bus != bus.index) {
+      return;
+    }
+    if (index < 0) {
+      Serial.println("updateDiscovery(): Neuer Sensor gefunden");
+      // Ein neuer parasitär versorgter DS18B20 macht den ganzen Bus parasitär. Geprüft wird vor registerSensor(), 
+      // damit schon das Beschreiben seiner Register mit Strong Pull-Up erfolgt.
+      if (getSensorTypeByFamily(deviceAddress[0], type) && type == 't' && bus.dallasSensors.readPowerSupply(deviceAddress)) {
+        bus.parasite = true;
+      }
+      index = registerSensor(bus, deviceAddress);
+      if (index < 0) {
+        return;
+      }
+      initSensorSchedule(index);
+      initalClear = false;
+    }
+    sensors.sensorList[index].seen = true;
+    return;
+  }
+
+  // Liefert schon der erste Schritt nichts, hat kein Gerät auf den Reset geantwortet
+  if (bus.discoveryFound == 0) {
+    profileEnd(start, P_SEARCH, nullptr, bus.index, PR_NO_PRESENCE);
+  }
+
+  // Suchlauf beendet, entferne Sensoren, die zu oft gefehlt haben. Abgeleitete Sensoren hängen an keinem Bus.
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used || sensors.sensorList[i].bus != bus.index || sensors.sensorList[i].type == T_VIRTUAL) {
+      continue;
+    }
+    if (sensors.sensorList[i].seen) {
+      sensors.sensorList[i].missed = 0;
+    } else if (++sensors.sensorList[i].missed >= discoveryMissLimit) {
+      Serial.print("updateDiscovery(): Sensor ");
+      Serial.print(sensors.sensorList[i].address);
+      Serial.println(" entfernt");
+      removeSensor(deviceAddressToRom(sensors.sensorList[i].deviceAddress));
+      changed = true;
+    }
+  }
+  if (changed) {
+    initalClear = false;
+  }
+  bus.discoveryLast   = millis();
+  bus.discoveryState  = DISCOVERY_IDLE;
+
+  // Halte den Cache für den nächsten Warmstart aktuell, entprellt und begrenzt durch saveTopology()
+  saveTopology();
+}
+
+boolean startStream(const int index, const int channel) {
+  // Nur ein DS2438 mit gebundenem Treiber kann gestreamt werden
+  if (index < 0 || index >= sensors.slots || !sensors.sensorList[index].used || sensors.sensorList[index].type != 'b' || sensors.sensorList[index].probe < 0) {
+    return false;
   }
+  stopStream();
+  streamSensor  = index;
+  streamChannel = channel;
+  streamSamples = 0;
+  streamState   = STREAM_SELECT;
+  Serial.print("startStream(): DS2438 ");
+  Serial.print(sensors.sensorList[index].address);
+  Serial.print(" Kanal ");
+  Serial.println(channel == DS2438_CHA ? "A" : "B");
+  Serial.println("stream;Zeit [ms];Spannung [V]");
+  return true;
+}
 
-  // Starte Objekt für Temperatur-Sensoren
-  dallasSensors.begin();
+void stopStream() {
+  if (streamState == STREAM_OFF) {
+    return;
+  }
+  Serial.print("stopStream(): ");
+  Serial.print(streamSamples);
+  Serial.println(" Messwerte gestreamt");
+  if (streamClient.connected()) {
+    streamClient.stop();
+  }
+  streamState   = STREAM_OFF;
+  streamSensor  = -1;
+}
+
+boolean isStreaming(const Sensor &sensor) {
+  return streamState != STREAM_OFF && &sensor == &sensors.sensorList[streamSensor];
+}
+
+boolean loadVirtualSensors() {
+  VirtualSensors tempVirtualSensors;
+
+  Serial.println("loadVirtualSensors() begin");
+  virtualStorage.read(tempVirtualSensors);
+  if (strcmp(tempVirtualSensors.head, "MRAv") == 0 && strcmp(tempVirtualSensors.foot, "MRAw") == 0) {
+    virtualSensors = tempVirtualSensors;
+    // Schütze vor einem Ausdruck ohne Ende, z.B. nach einem unterbrochenen Schreiben
+    for (int i = 0; i < virtualSensorCount; i++) {
+      virtualSensors.expressions[i][virtualExpressionSize - 1] = '\0';
+    }
+    Serial.println("loadVirtualSensors() end");
+    return true;
+  }
+  virtualSensors = VirtualSensors();
+  Serial.println("  Keine abgeleiteten Sensoren vorhanden");
+  Serial.println("loadVirtualSensors() end");
+  return false;
+}
+
+void saveVirtualSensors() {
+  Serial.println("saveVirtualSensors(): Speichere abgeleitete Sensoren");
+  virtualStorage.write(virtualSensors);
+}
+
+void virtualSensorAddress(const int index, DeviceAddress deviceAddress) {
+  memset(deviceAddress, 0, sizeof(DeviceAddress));
+  deviceAddress[0] = virtualSensorFamily;
+  deviceAddress[1] = index + 1;
+}
+
+boolean resolveSensorName(const char *name, DeviceAddress deviceAddress) {
+  // Sucht den Namen in der Sensor-Konfig, so lassen sich Ausdrücke auch vor der Erkennung der Sensoren übersetzen
+  SensorConfig  sensorConfig;
+  int           length;
+
+  for (int i = 0; i < configRecordCount; i++) {
+    if (getSensorRecord(config, configRecordOffsets[i], deviceAddress, sensorConfig, length) && strcmp(sensorConfig.name, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setupVirtualSensors() {
+  // Übersetzt die Ausdrücke und nimmt die abgeleiteten Sensoren (erneut) in die Sensorliste auf
+  DeviceAddress deviceAddress;
+  SensorConfig  tempConfig;
+  Sensor        sensor;
+
+  Serial.println("setupVirtualSensors() begin");
+  for (int i = 0; i < virtualSensorCount; i++) {
+    VirtualProgram &program = virtualPool[i];
+
+    virtualSensorAddress(i, deviceAddress);
+    if (findSensor(deviceAddress) >= 0) {
+      removeSensor(deviceAddressToRom(deviceAddress));
+    }
+    program = VirtualProgram();
+    if (virtualSensors.expressions[i][0] == '\0' || !compileVirtualExpression(virtualSensors.expressions[i], program, resolveSensorName)) {
+      continue;
+    }
+
+    sensor = Sensor();
+    copyDeviceAddress(deviceAddress, sensor.deviceAddress);
+    deviceAddressToHex(deviceAddress, sensor.address);
+    sensor.type   = T_VIRTUAL;
+    // Bis zur ersten Berechnung gibt es keinen Wert
+    sensor.status = S_NO_PRESENCE;
+    sensor.health = H_DEGRADED;
+    if (getSensorConfig(deviceAddress, tempConfig)) {
+      sensor.config = tempConfig;
+    }
+    program.sensor = addSensor(sensor);
+    Serial.print("  Abgeleiteter Sensor ");
+    Serial.print(sensor.address);
+    Serial.print(": ");
+    Serial.print(program.length);
+    Serial.print(" Bytes Bytecode, ");
+    Serial.print(program.inputCount);
+    Serial.println(" Eingangswerte");
+  }
+  initalClear = false;
+  Serial.println("setupVirtualSensors() end");
+}
+
+boolean readVirtualInput(const VirtualInput &input, SensorRaw &raw, SensorUnit &unit) {
+  // Liefert den aktuellen Wert eines Verweises, false wenn der Sensor fehlt, gestört ist oder den Kanal nicht wandelt
+  int index = findSensorByRom(input.rom);
+
+  if (index < 0) {
+    return false;
+  }
+  Sensor &sensor = sensors.sensorList[index];
+  if (sensor.status != S_OK || sensor.health != H_OK) {
+    return false;
+  }
+  if (input.channel == VC_VALUE) {
+    raw   = sensor.raw;
+    unit  = sensor.unit;
+    return true;
+  }
+  if (sensor.type != T_DS2438 || sensor.probe < 0) {
+    return false;
+  }
+  DS2438 &probe = ds2438Pool[sensor.probe].driver;
+  switch (input.channel) {
+    case VC_CHANNEL_A:
+      raw   = probe.getVoltageRaw(DS2438_CHA);
+      unit  = U_VOLTAGE;
+      return sensor.config.channels & DS2438_MODE_CHA;
+    case VC_CHANNEL_B:
+      raw   = probe.getVoltageRaw(DS2438_CHB);
+      unit  = U_VOLTAGE;
+      return sensor.config.channels & DS2438_MODE_CHB;
+    default:
+      // Volle Auflösung des DS2438, ein Schieben auf U_TEMPERATURE würde das Bit für 1/32 °C verwerfen
+      raw   = probe.getTemperatureRaw();
+      unit  = U_TEMPERATURE_FINE;
+      return sensor.config.channels & DS2438_MODE_TEMPERATURE;
+  }
+}
+
+void updateVirtualSensors() {
+  /*
+    Berechnet die abgeleiteten Sensoren, aber nur, wenn sich seit der letzten Berechnung einer ihrer Eingangswerte 
+    geändert hat. Fehlt ein Eingangswert, gilt der abgeleitete Sensor als gestört.
+  */
+  VirtualValue  values[virtualInputCount];
+  VirtualValue  result;
+  int64_t       scaled;
+  SensorRaw     raw;
+  SensorUnit    unit;
+  boolean       changed;
+  boolean       available;
+
+  for (int i = 0; i < virtualSensorCount; i++) {
+    VirtualProgram &program = virtualPool[i];
+    if (program.sensor < 0) {
+      continue;
+    }
+    Sensor &sensor = sensors.sensorList[program.sensor];
+
+    // Ohne gültigen Wert (z.B. gleich nach dem Übersetzen) wird in jedem Fall gerechnet
+    changed   = sensor.status != S_OK && sensor.status != S_INVALID_VALUE;
+    available = true;
+    for (int j = 0; j < program.inputCount; j++) {
+      VirtualInput &input = program.inputs[j];
+      if (!readVirtualInput(input, raw, unit)) {
+        available = false;
+        break;
+      }
+      values[j] = ((VirtualValue)raw * 65536) / unit;
+      if (!input.valid || raw != input.last) {
+        input.last  = raw;
+        input.valid = true;
+        changed     = true;
+      }
+    }
+    if (!available) {
+      sensor.status = S_NO_PRESENCE;
+      sensor.health = H_DEGRADED;
+      continue;
+    }
+    if (!changed) {
+      continue;
+    }
+    // Auch ein Ergebnis, das in Tausendsteln nicht mehr in SensorRaw passt, ist ein Überlauf
+    if (evaluateVirtualProgram(program, values, result) && 
+        (scaled = (result * U_MILLI + 32768) >> 16) <= INT32_MAX && scaled >= INT32_MIN) {
+      sensor.raw    = scaled;
+      sensor.status = S_OK;
+      sensor.health = H_OK;
+    } else {
+      sensor.status = S_INVALID_VALUE;
+      sensor.health = H_DEGRADED;
+    }
+  }
+}
+
+void updateStream() {
+  /*
+    Diagnose-Modus für die Inbetriebnahme einer Tanksonde: Ein einzelner DS2438 wandelt ohne Pause nur noch die 
+    Spannung des gewählten Kanals, der Kanal wird einmalig eingestellt. Bei ca. 8 ms Wandlungszeit plus Lesen sind so 
+    je nach Dauer von loop() 20 bis 50 Messwerte pro Sekunde möglich. Jeder Messwert wird mit Zeitstempel seriell und 
+    an den HTTP-Client ausgegeben, bis /stream/stop aufgerufen oder der Client getrennt wird.
+    Die übrigen Sensoren werden weiter abgefragt, nur dieser DS2438 nimmt so lange nicht an updateLevels() teil.
+  */
+  uint16_t      voltage;
+  char          value[10];
+  boolean       success;
+  unsigned long start;
+
+  if (streamState == STREAM_OFF) {
+    return;
+  }
+
+  // Wurde der HTTP-Client getrennt, endet das Streaming
+  if (!streamClient.connected()) {
+    stopStream();
+    return;
+  }
+
+  Sensor      &sensor = sensors.sensorList[streamSensor];
+  OneWireBus  &bus    = buses[sensor.bus];
+  DS2438      &probe  = ds2438Pool[sensor.probe].driver;
+
+  // Bei parasitärer Versorgung darf der Bus während einer laufenden Wandlung nicht angesprochen werden, weder während 
+  // der der DS18B20 noch während der per Skip ROM gestarteten der DS2438
+  if (bus.parasite && (bus.tempState == TEMP_CONVERTING || bus.tempState == TEMP_ALARM_SEARCH || 
+                       bus.levelState == LEVEL_CONVERT_T || bus.levelState == LEVEL_CONVERT_V)) {
+    return;
+  }
+
+  switch (streamState) {
+    case STREAM_SELECT:
+      start = busAccessStart(bus);
+      success = probe.prepareChannel(streamChannel);
+      profileEnd(start, P_SELECT_CHANNEL, sensor.deviceAddress, bus.index, getProbeProfileResult(probe, success));
+      if (!success) {
+        Serial.println("updateStream(): Kanal konnte nicht eingestellt werden");
+        stopStream();
+        return;
+      }
+      start = busAccessStart(bus);
+      probe.startVoltageConversion();
+      profileEnd(start, P_CONVERT_V, sensor.deviceAddress, bus.index, PR_OK);
+      streamState = STREAM_CONVERTING;
+      return;
+
+    case STREAM_CONVERTING:
+      if (!probe.isConversionDone()) {
+        return;
+      }
+      start = busAccessStart(bus);
+      success = probe.readVoltageRaw(voltage);
+      profileEnd(start, P_READ_PAGE, sensor.deviceAddress, bus.index, getProbeProfileResult(probe, success));
+      if (success) {
+        streamSamples++;
+        formatFixed(voltage, 2, value, sizeof(value));
+        Serial.print("stream;");
+        Serial.print(probe.getTimestamp());
+        Serial.print(";");
+        Serial.println(value);
+        streamClient.print(probe.getTimestamp());
+        streamClient.print(";");
+        streamClient.println(value);
+      } else {
+        Serial.println("stream;Prüfsummenfehler");
+      }
+      // Starte sofort die nächste Wandlung
+      start = busAccessStart(bus);
+      probe.startVoltageConversion();
+      profileEnd(start, P_CONVERT_V, sensor.deviceAddress, bus.index, PR_OK);
+      return;
+
+    default:
+      return;
+  }
+}
+
+void setup1Wire() {
+  byte              addrArray[8];
+  DeviceAddress     deviceAddress;
+  int               deviceCount = 0;
+  int               cachedCount;
+
+  Serial.println("setup1Wire() begin");
 
   // Leere die Liste
   clearSensorList();
 
-  // Gib die gefundenen Sensoren aus
-  Serial.println("  Gefundene 1-Wire-Sensoren:");
-  tft.println("Gefundene 1-Wire-Sensoren:");
-  printSensorAddresses();
+  for (int b = 0; b < oneWireBusCount; b++) {
+    OneWireBus &bus = buses[b];
+    bus.index = b;
+    Serial.print("  Bus ");
+    Serial.print(b);
+    Serial.print(" an Pin D");
+    Serial.println(PinOneWireBus[b]);
+
+    // Initialisiere die OneWire- und DallasTemperature-Bibliotheken
+    bus.oneWire.begin(PinOneWireBus[b]);
+    bus.dallasSensors.setOneWire(&bus.oneWire);
+
+    // Warmstart: Übernimm die Geräte aus dem Cache, die Suche läuft danach im Hintergrund. Ohne begin() kennt 
+    // DallasTemperature die Versorgung nicht, Schreibzugriffe laufen daher über writeTemperatureRegisters() und bus.parasite.
+    cachedCount = setupBusFromTopology(bus);
+    if (cachedCount > 0) {
+      deviceCount += cachedCount;
+      continue;
+    }
 
-  // Iteriere durch alle Sensoren
-  for (int i = 0; i < dallasSensors.getDeviceCount(); i++) {
-    
-    // Ermittle die Adresse
-    Serial.println("  Ermittle Adresse Sensor " + String(i));
-    dallasSensors.getAddress(sensor.deviceAddress, i); 
-    address = deviceAddressToStr(sensor.deviceAddress);
-    strcpy (sensor.address, address.c_str());
-    Serial.println("  address: " + address);
-    Serial.print("  addressC: ");
-    Serial.println(sensor.address);
-    
-    // Ermittle den Typ
-    Serial.println("  Ermittle Typ Sensor " + String(i));
-    if (getSensorTypeByAddress(sensor.address, sensor.type) == true) {
-      Serial.println("  Typ erfolgreich ermittelt");
-    } else {
-      Serial.println("  Typ nicht erfolgreich ermittelt");
-    }
-    Serial.print("  Typ Sensor " + String(i) + ": ");
-    Serial.println(sensor.type);
-
-    // Ermittle die Konfig
-    Serial.println("  Ermittle Config Sensor " + String(i));
-    if (getSensorConfig(sensor.address, tempConfig) == true) {
-      Serial.println("  Config erfolgreich ermittelt");
-      strcpy( sensor.config.name,         tempConfig.name);
-      strcpy( sensor.config.format,       tempConfig.format);
-              sensor.config.formatMin   = tempConfig.formatMin;
-              sensor.config.formatMax   = tempConfig.formatMax;
-              sensor.config.precision   = tempConfig.precision;
-              sensor.config.min         = tempConfig.min;
-              sensor.config.max         = tempConfig.max;
+    if (bus.oneWire.search(addrArray)) {
     } else {
-      Serial.println("  Config nicht erfolgreich ermittelt");
+      tft.println("Keine Geräte gefunden");
+      Serial.println("  Keine Geräte gefunden");
     }
 
-    // Füg den Sensor der Liste hinzu
-    addSensor(sensor);
-  }  
+    // Starte Objekt für Temperatur-Sensoren
+    bus.dallasSensors.begin();
+
+    // requestTemperatures() soll nicht auf das Ende der Wandlung warten, das übernimmt updateTemperatures()
+    bus.dallasSensors.setWaitForConversion(false);
+
+    // Ermittle die Versorgung des Busses. begin() hat dazu bereits jeden DS18B20 per readPowerSupply() befragt.
+    // Ein ungezieltes readPowerSupply() per Skip-ROM ist hier nicht möglich, da 0xB4 bei den DS2438 eine Spannungs-Wandlung startet.
+    bus.parasite = bus.dallasSensors.isParasitePowerMode();
+    Serial.print("  Versorgung des Busses: ");
+    Serial.println(bus.parasite ? "parasitär, feste Wandlungszeiten" : "extern, Wandlungsende wird abgefragt");
+
+    // Gib die gefundenen Sensoren aus
+    Serial.println("  Gefundene 1-Wire-Sensoren:");
+    tft.println("Gefundene 1-Wire-Sensoren:");
+    printSensorAddresses(bus);
+
+    // Iteriere durch alle Sensoren
+    for (int i = 0; i < bus.dallasSensors.getDeviceCount(); i++) {
+      bus.dallasSensors.getAddress(deviceAddress, i); 
+      registerSensor(bus, deviceAddress);
+    }  
+    deviceCount += bus.dallasSensors.getDeviceCount();
+  }
 
   #ifdef DRYRUN
-    if (dallasSensors.getDeviceCount() <= 0) {
+    if (deviceCount <= 0) {
       Serial.println("  Dryrun, erzeuge Dummy-Geräte");
       tft.println("Dryrun, erzeuge Dummy-Geraete");
       dummySensors = true;
-      addSensor("28EE3F8C251601", "Dmy Tmp 1", T_DS18B20, "%2s C", -1,  -1, 0, -1,  -1, 23);
-      addSensor("28FF3F8C251601", "Dmy Tmp 2", T_DS18B20, "%2s C", -1,  -1, 0, -1,  -1, 40);
-      addSensor("33EB3F8C251601", "Dmy Lvl 1", T_DS2438,  "%2s %%", 0, 120, 0,  0, 100, 25);
-      addSensor("33EA3F8C251601", "Dmy Lvl 2", T_DS2438,  "%2s %%", 0, 100, 0,  0,   2, 1.5);
+      // Vollständige ROM-Codes mit Familie (0x28 DS18B20, 0x26 DS2438) und CRC, sonst hätten alle denselben Schlüssel
+      addSensor("28EE3F8C251601BD", "Dmy Tmp 1", T_DS18B20, "%2s C", -1,  -1, 0, -1,  -1, 23);
+      addSensor("28FF3F8C251601D1", "Dmy Tmp 2", T_DS18B20, "%2s C", -1,  -1, 0, -1,  -1, 40);
+      addSensor("26EB3F8C25160129", "Dmy Lvl 1", T_DS2438,  "%2s %%", 0, 120, 0,  0, 100, 25);
+      addSensor("26EA3F8C2516011E", "Dmy Lvl 2", T_DS2438,  "%2s %%", 0, 100, 0,  0,   2, 1.5);
     }
   #endif
 
-  updateTemperatures();
-  updateLevels();
+  // Plane alle Sensoren zur Abfrage ein
+  setupSchedule();
+
+  // Starte die erste Wandlung sofort
+  for (int b = 0; b < oneWireBusCount; b++) {
+    updateTemperatures(buses[b]);
+    updateLevels(buses[b]);
+  }
+
+  // Die abgeleiteten Sensoren verweisen auf die eben aufgenommenen
+  setupVirtualSensors();
+
+  // Halte den Cache für den nächsten Warmstart aktuell, beim Warmstart nur bei geänderter Konfig
+  saveTopology(true);
   Serial.println("setup1Wire() end");
 }
 
+int setupBusFromTopology(OneWireBus &bus) {
+  /*
+    Übernimmt die im Cache gespeicherten Geräte des Busses ohne Suche, begin() und Lesen der Register. Bis zur 
+    ersten Abfrage vergeht so nur noch die Zeit einer Wandlung, statt einer Suche plus mehreren Zugriffen je Sensor.
+    Die übernommenen Sensoren gelten als unbestätigt: Fehlen sie im sofort gestarteten ersten Suchlauf, werden sie 
+    entfernt, neue Geräte werden wie zur Laufzeit aufgenommen.
+  */
+  int count = 0;
+  int index;
+
+  if (dummySensors) {
+    return 0;
+  }
+  for (int i = 0; i < topology.count; i++) {
+    if (topology.entries[i].bus != bus.index || findSensor(topology.entries[i].address) >= 0) {
+      continue;
+    }
+    index = registerSensor(bus, topology.entries[i].address, &topology.entries[i]);
+    if (index < 0) {
+      break;
+    }
+    sensors.sensorList[index].missed = discoveryMissLimit - 1;
+    count++;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  bus.parasite = topology.parasite[bus.index];
+  Serial.print("  Warmstart, Geräte aus dem Cache: ");
+  Serial.println(count);
+  Serial.print("  Versorgung des Busses laut Cache: ");
+  Serial.println(bus.parasite ? "parasitär, feste Wandlungszeiten" : "extern, Wandlungsende wird abgefragt");
+  tft.print("Warmstart, Geraete: ");
+  tft.println(count);
+
+  // Bestätige die Liste im Hintergrund, die Suche lässt den fälligen Abfragen den Vortritt
+  startDiscovery(bus);
+  return count;
+}
+
+const SensorSnapshot& currentSnapshot() {
+  return snapshots[snapshotFront];
+}
+
+void publishSnapshot() {
+  /*
+    Überträgt die Sensorliste in den hinteren Puffer und macht ihn zum vorderen, sofern sich seit der letzten 
+    Aufnahme etwas geändert hat. Unveränderte Sensoren werden aus dem vorderen Puffer kopiert statt neu formatiert.
+    Der Tausch ist ein einziger Schreibzugriff auf snapshotFront, ein Leser sieht also entweder den alten oder den 
+    neuen Stand, nie einen halb geschriebenen.
+  */
+  const SensorSnapshot  &front    = snapshots[snapshotFront];
+  SensorSnapshot        &back     = snapshots[snapshotFront ^ 1];
+  boolean               changed   = snapshotStale;
+  int                   count     = 0;
+
+  // Ohne Formatieren prüfen, ob Plätze, Werte und Zustände noch zum vorderen Puffer passen
+  for (int i = 0; i < sensors.slots && !changed; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    changed = count >= front.count || !isSensorViewCurrent(front.views[count], sensors.sensorList[i], i);
+    count++;
+  }
+  if (!changed && count == front.count) {
+    return;
+  }
+
+  count = 0;
+  for (int i = 0; i < sensors.slots; i++) {
+    if (!sensors.sensorList[i].used) {
+      continue;
+    }
+    if (!snapshotStale && count < front.count && isSensorViewCurrent(front.views[count], sensors.sensorList[i], i)) {
+      back.views[count] = front.views[count];
+    } else {
+      fillSensorView(sensors.sensorList[i], i, back.views[count]);
+    }
+    count++;
+  }
+  back.count    = count;
+  back.version  = front.version + 1;
+  snapshotFront ^= 1;
+  snapshotStale = false;
+}
+
 String getValuesAsHtml() {
-  String address;
-  String temp;
-  SensorName name;
-  char buffer[10];
-  String returnString = "";
+  // Erzeugt den Text nur neu, wenn es eine neue Momentaufnahme gibt
+  const SensorSnapshot &snapshot = currentSnapshot();
+  String line;
+
+  if (snapshot.version == htmlVersion) {
+    return htmlValues;
+  }
 
   Serial.println("getValuesAsHtml() begin");
-  for (int i = 0; i < sensors.count; i++) {
-  // Iteriere durch alle Sensoren
-    // und wenn ein Name gesetzt ist,
-    if (!sensors.sensorList[i].config.name[0] == '\0') {
-      // Nimm den
-      strcpy(name, sensors.sensorList[i].config.name);
+  htmlValues = "";
+  for (int i = 0; i < snapshot.count; i++) {
+    const SensorView &view   = snapshot.views[i];
+    const Sensor     &sensor = sensors.sensorList[view.slot];
+    // Bei einem gestörten Sensor ist der Wert veraltet, zeig stattdessen den Zustand an
+    if (view.health == H_OK) {
+      line = String(sensorLabel(sensor)) + ": " + String(view.display) + " (Bus " + String(sensor.bus) + ")</br>";
     } else {
-      // Sonst die Adresse
-      strcpy(name, sensors.sensorList[i].address);
+      line = String(sensorLabel(sensor)) + ": " + String(sensorHealthToStr(view.health)) + ", " + String(view.failures) + " Fehler (Bus " + String(sensor.bus) + ")</br>";
     }
-    // Formattiere den Wert entspr. dem Value String
-    sensorValueToDisplay(sensors.sensorList[i], buffer);
-    returnString = returnString + String(name) + ": " + String(buffer) + "</br>";
-
-    Serial.println("  Ermittle Inhalt für Webserver: " + returnString);
+    Serial.println("  Ermittle Inhalt für Webserver: " + line);
+    htmlValues += line;
   }
-  return returnString;
+  htmlVersion = snapshot.version;
   Serial.println("getValuesAsHtml() end");
+  return htmlValues;
 }
 
 void setup() {
@@ -1082,10 +3301,16 @@ void setup() {
   // Konfig
   setupMemory();
   loadConfig(); // Achtung! Schlägt direkt nach dem Upload fehl
+  loadTopology();
+  loadCalibrations();
+  loadVirtualSensors();
 
   // Display
   setupDisplay();
 
+  // Öffne den 1-Wire Bus vor dem WLAN, so läuft die erste Wandlung während des Verbindungsaufbaus
+  setup1Wire();
+
   // Stelle Verbindung mit dem WLAN her
   setupWifi();
   checkWiFi();
@@ -1093,13 +3318,11 @@ void setup() {
   // Verbinde mit dem MQTT-Server
   connectToMQTT();
 
-  // Öffne den 1-Wire Bus
-  setup1Wire();
-
   // Gib die gefundenen Sensoren seriell aus
   printSensors();
 
   // Erzeuge die Sensor-Beschriftungen
+  publishSnapshot();
   displayBackground();
 
   Serial.println("setup() end");
@@ -1241,8 +3464,9 @@ boolean connectToMQTT() {
 }
 
 void displayBackground() {
+  const SensorSnapshot &snapshot = currentSnapshot();
   int         height      = tft.height() - yBegin;
-  int         lineheight  = height / sensors.count;
+  int         lineheight  = height / snapshot.count;
   int         line        = yBegin;
 
   Serial.println("displayBackground() begin"); 
@@ -1255,7 +3479,7 @@ void displayBackground() {
   #endif
 
   // Wenn keine Sensoren erkannt wurden, brich ab
-  if (sensors.count <= 0) {
+  if (snapshot.count <= 0) {
   Serial.println("  Keine Sensoren vorhanden, breche ab"); 
   Serial.println("displayBackground() end"); 
     return;
@@ -1265,17 +3489,11 @@ void displayBackground() {
 
   // Beschriftungen
   tft.setTextSize(1);
-  for (int i = 0; i <= sensors.count; i++) {
+  for (int i = 0; i < snapshot.count; i++) {
     tft.setCursor(xBegin, line);
 
-    // Wenn ein Name gesetzt ist,
-    if (!sensors.sensorList[i].config.name[0] == '\0') {
-      // Nimm den
-      tft.println(sensors.sensorList[i].config.name);
-    } else {
-      // Sonst die Adresse
-      tft.println(sensors.sensorList[i].address);
-    }
+    // Name, sonst die Adresse
+    tft.println(sensorLabel(sensors.sensorList[snapshot.views[i].slot]));
     line = line + lineheight;
   }
   tft.setCursor(xBegin, yBegin);
@@ -1283,14 +3501,19 @@ void displayBackground() {
 }
 
 void displayValues() {
-  char        buffer[10];
+  const SensorSnapshot &snapshot = currentSnapshot();
+  char        buffer[sensorDisplaySize];
   int         height      = tft.height() - yBegin;
-  int         lineheight  = height / sensors.count;
+  int         lineheight  = height / snapshot.count;
   int         line        = yBegin;
   // Brich ab, wenn unser Inverall noch nicht erreicht ist
   if (millis() < displayLast + (displayInterval * 1000)) {
     return;
   }
+  // Brich ab, wenn seit dem letzten Zeichnen nichts Neues vorliegt und die Beschriftungen noch stimmen
+  if (initalClear && snapshot.version == displayVersion) {
+    return;
+  }
   displayLast = millis();
  
   Serial.println("displayValues() begin"); 
@@ -1301,8 +3524,10 @@ void displayValues() {
     initalClear = true;
   }
 
+  displayVersion = snapshot.version;
+
   // Fehlermeldung, wenn keine Sensoren gefunden wurden
-  if (sensors.count <= 0) {
+  if (snapshot.count <= 0) {
     Serial.println("  Keine Sensoren gefunden, deren Daten angezeigt werden könnten"); 
     Serial.println("displayValues() end"); 
     return;
@@ -1311,11 +3536,11 @@ void displayValues() {
   tft.setTextSize(2);
 
   // Iteriere durch alle Sensoren
-  for (int i = 0; i < sensors.count; i++) {
-    // Formattiere den Wert entspr. dem Value String
-    sensorValueToDisplay(sensors.sensorList[i], buffer);
+  for (int i = 0; i < snapshot.count; i++) {
+    // Der Wert ist schon formatiert, fillBlank() braucht aber eine eigene Kopie
+    strcpy(buffer, snapshot.views[i].display);
 
-    if (sensors.count <= 4) {
+    if (snapshot.count <= 4) {
       tft.setCursor(40, line+10); // Bleiben noch 8 Zeichen
       strcpy(buffer, fillBlank(buffer, 8));
     } else {
@@ -1352,7 +3577,8 @@ void reset() {
 }
 
 void sendTemperaturesToMQTT() {
-  char topic[30] = "n/a";
+  const SensorSnapshot &snapshot = currentSnapshot();
+  char topic[40] = "n/a";   // Längstes Thema: "sensor/" + 16 Zeichen Adresse + "/temperature" + '\0' = 36
   char payload[10];
 
   // Prüfe, ob WiFi überhaupt aktivier tist
@@ -1364,6 +3590,11 @@ void sendTemperaturesToMQTT() {
   if (millis() < sendLast + (sendInterval * 1000)) {
     return;
   }
+  // Brich ab, wenn seit der letzten Übermittlung nichts Neues vorliegt. Nach einem Verbindungsabbruch wird alles 
+  // erneut übermittelt.
+  if (snapshot.version == mqttVersion && mqttClient.connected()) {
+    return;
+  }
   sendLast = millis();
 
   // Wenn MQTT noch nicht verbunden ist
@@ -1378,37 +3609,51 @@ void sendTemperaturesToMQTT() {
   }
 
   // Fehlermeldung, wenn keine Sensoren gefunden wurden
-  if (dallasSensors.getDeviceCount() <= 0) {
+  if (snapshot.count <= 0) {
     Serial.println("sendTemperaturesToMQTT(): Keine Sensoren gefunden, deren Daten übermittelt werden könnten"); 
   }
 
   // Iteriere durch alle Sensoren
-  for (int i = 0; i < sensors.count; i++) {
+  for (int i = 0; i < snapshot.count; i++) {
+    const SensorView &view   = snapshot.views[i];
+    const Sensor     &sensor = sensors.sensorList[view.slot];
     // Ermittle die Temperatur
     Serial.println("  Ermittle temperatur sensor " + String(i));
     // Und bilde die MQTT-Nachricht
-    strcpy(topic, "sensor/");
-    strcat(topic, sensors.sensorList[i].address);
-    strcat(topic, "/temperature");
-    dtostrf(sensors.sensorList[i].value, 3, 2, payload);
+    snprintf(topic, sizeof(topic), "sensor/%s/temperature", sensor.address);
+    formatFixed(rawToHundredths(view.raw, sensor.unit), 2, payload, sizeof(payload));
     
-    Serial.print("topic: ");
-    Serial.print(topic);
-    Serial.print(" - payload: ");
-    Serial.println(payload);
+    // Ein gestörter Sensor hat keinen aktuellen Wert, übermittelt wird nur sein Zustand
+    if (view.health == H_OK) {
+      Serial.print("topic: ");
+      Serial.print(topic);
+      Serial.print(" - payload: ");
+      Serial.println(payload);
+      mqttClient.publish(topic, payload);
+    }
+
+    // Übermittle den Zustand: 0 = ok, 1 = gestört, 2 = Quarantäne
+    snprintf(topic, sizeof(topic), "sensor/%s/health", sensor.address);
+    itoa(view.health, payload, 10);
+    mqttClient.publish(topic, payload);
+
+    // Übermittle den Bus, an dem der Sensor hängt
+    snprintf(topic, sizeof(topic), "sensor/%s/bus", sensor.address);
+    itoa(sensor.bus, payload, 10);
     mqttClient.publish(topic, payload);
   }
+  mqttVersion = snapshot.version;
 }
 
-void printSensorAddresses() {
+void printSensorAddresses(OneWireBus &bus) {
   DeviceAddress tempAddress;
 
   Serial.print("  Anzahl: ");
-  Serial.println(dallasSensors.getDeviceCount());
+  Serial.println(bus.dallasSensors.getDeviceCount());
   tft.print("Anzahl: ");
-  tft.println(dallasSensors.getDeviceCount());
-  for (int i = 0; i < dallasSensors.getDeviceCount(); i++) {   
-    dallasSensors.getAddress(tempAddress, i);
+  tft.println(bus.dallasSensors.getDeviceCount());
+  for (int i = 0; i < bus.dallasSensors.getDeviceCount(); i++) {   
+    bus.dallasSensors.getAddress(tempAddress, i);
 
     Serial.print("  Sensor ");
     Serial.print(i);
@@ -1437,8 +3682,17 @@ void loop() {
 
   checkWiFi();
 
-  updateTemperatures();
-  updateLevels();
+  // Jeder Bus erhält pro Durchlauf einen Schritt, so laufen Wandlungen und Lesezugriffe der Busse verschränkt
+  for (int b = 0; b < oneWireBusCount; b++) {
+    updateTemperatures(buses[b]);
+    updateLevels(buses[b]);
+    updateDiscovery(buses[b]);
+  }
+  updateStream();
+  updateVirtualSensors();
+
+  // Veröffentliche die Messwerte für Anzeige, MQTT und Webserver
+  publishSnapshot();
 
   displayValues(); 
 
@@ -0,0 +1,227 @@
+#include <Arduino.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+
+/*
+    Profiler für den 1-Wire-Bus, wird nur mit #define PROFILER vor dem Einbinden übersetzt.
+
+    OneWire, DallasTemperature und DS2438 rufen reset(), select(), write() und read() direkt und nicht virtuell auf,
+    ein Einklinken in die einzelnen Aufrufe ist daher nicht möglich. Erfasst wird stattdessen jede Bus-Operation
+    (z.B. "Scratchpad lesen" = Reset, Select, Befehl, 9 Bytes, CRC) an der Aufrufstelle in main.cpp:
+
+    unsigned long start = profileStart();
+    ...Bus-Operation...
+    profileEnd(start, P_READ_SCRATCHPAD, deviceAddress, bus.index, PR_OK);
+
+    Je Befehl, je Gerät und je Bus werden Anzahl, Summe und Maximum der Dauer in Mikrosekunden, fehlende
+    Presence-Pulse, CRC-Fehler sowie ein Histogramm der Dauer in festen Stufen geführt. Ausgabe per printProfile().
+*/
+
+typedef enum {
+  P_CONVERT_T       = 0,  // Temperatur-Wandlung per Skip ROM (DS18B20 und DS2438)
+  P_CONVERT_V       = 1,  // Spannungs-Wandlung eines DS2438, per Skip ROM oder adressiert beim Streaming
+  P_READ_SCRATCHPAD = 2,  // Scratchpad eines DS18B20 lesen
+  P_SELECT_CHANNEL  = 3,  // Kanal eines DS2438 einstellen (Lesen und ggf. Schreiben von Seite 0)
+  P_READ_PAGE       = 4,  // Seite 0 eines DS2438 lesen
+  P_ALARM_SEARCH    = 5,  // Ein Schritt der Alarm-Suche
+  P_SEARCH          = 6,  // Ein Schritt der Bus-Erkennung
+  P_COUNT           = 7
+} ProfileCommand;
+
+typedef enum {
+  PR_OK             = 0,  // Operation erfolgreich
+  PR_NO_PRESENCE    = 1,  // Kein Gerät hat auf den Reset geantwortet
+  PR_CRC_ERROR      = 2   // Prüfsumme falsch oder unplausible Daten
+} ProfileResult;
+
+#ifdef PROFILER
+
+const int profileBuckets      = 8;    // Stufen des Histogramms: < 250 µs, < 500 µs, ... < 16 ms, darüber
+const int profileDeviceCount  = 16;   // Gibt an, für wie viele Geräte eine eigene Statistik geführt wird
+const int profileBusCount     = 4;    // Gibt an, für wie viele Busse eine eigene Statistik geführt wird
+
+struct ProfileStats {
+  uint32_t              count           = 0;          // Anzahl der Operationen
+  uint32_t              totalMicros     = 0;          // Summe der Dauer
+  uint32_t              maxMicros       = 0;          // Längste Dauer
+  uint16_t              presenceFailures = 0;         // Anzahl fehlender Presence-Pulse
+  uint16_t              crcFailures     = 0;          // Anzahl der CRC-Fehler
+  uint16_t              histogram[profileBuckets] = {0};
+};
+
+struct ProfileDevice {
+  DeviceAddress         address;
+  uint8_t               bus             = 0;
+  boolean               used            = false;
+  ProfileStats          stats;
+};
+
+ProfileStats      profileCommands[P_COUNT];
+ProfileStats      profileBuses[profileBusCount];
+ProfileDevice     profileDevices[profileDeviceCount];
+
+#endif
+
+// *************** Deklaration der Funktionen
+unsigned long profileStart();
+void profileEnd(const unsigned long start, const ProfileCommand command, const uint8_t *device, const uint8_t bus, const ProfileResult result);
+void printProfile(Print &out);
+void resetProfile();
+const char* profileCommandToStr(const ProfileCommand command);
+
+// ***************  Funktionen
+#ifdef PROFILER
+
+void profileRecord(ProfileStats &stats, const unsigned long duration, const ProfileResult result) {
+  int bucket = 0;
+
+  stats.count++;
+  stats.totalMicros += duration;
+  if (duration > stats.maxMicros) {
+    stats.maxMicros = duration;
+  }
+  if (result == PR_NO_PRESENCE) {
+    stats.presenceFailures++;
+  } else if (result == PR_CRC_ERROR) {
+    stats.crcFailures++;
+  }
+  // Jede Stufe ist doppelt so breit wie die vorherige, beginnend bei 250 µs
+  while (bucket < profileBuckets - 1 && duration >= (250UL << bucket)) {
+    bucket++;
+  }
+  if (stats.histogram[bucket] < 0xFFFF) {
+    stats.histogram[bucket]++;
+  }
+}
+
+void printProfileStats(Print &out, const ProfileStats &stats) {
+  out.print(stats.count);
+  out.print(";");
+  out.print(stats.count > 0 ? stats.totalMicros / stats.count : 0);
+  out.print(";");
+  out.print(stats.maxMicros);
+  out.print(";");
+  out.print(stats.presenceFailures);
+  out.print(";");
+  out.print(stats.crcFailures);
+  for (int i = 0; i < profileBuckets; i++) {
+    out.print(";");
+    out.print(stats.histogram[i]);
+  }
+  out.println();
+}
+
+unsigned long profileStart() {
+  return micros();
+}
+
+void profileEnd(const unsigned long start, const ProfileCommand command, const uint8_t *device, const uint8_t bus, const ProfileResult result) {
+  unsigned long duration = micros() - start;
+  int           slot     = -1;
+
+  profileRecord(profileCommands[command], duration, result);
+  if (bus < profileBusCount) {
+    profileRecord(profileBuses[bus], duration, result);
+  }
+
+  // Broadcasts und Suchen haben kein einzelnes Gerät
+  if (device == nullptr) {
+    return;
+  }
+  for (int i = 0; i < profileDeviceCount; i++) {
+    if (profileDevices[i].used && memcmp(profileDevices[i].address, device, 8) == 0) {
+      slot = i;
+      break;
+    }
+    if (!profileDevices[i].used && slot < 0) {
+      slot = i;
+    }
+  }
+  // Alle Plätze belegt, das Gerät erscheint nur in den Statistiken je Befehl und Bus
+  if (slot < 0) {
+    return;
+  }
+  if (!profileDevices[slot].used) {
+    memcpy(profileDevices[slot].address, device, 8);
+    profileDevices[slot].bus  = bus;
+    profileDevices[slot].used = true;
+  }
+  profileRecord(profileDevices[slot].stats, duration, result);
+}
+
+void printProfile(Print &out) {
+  out.println("Profil;Anzahl;Mittel [us];Max [us];Presence-Fehler;CRC-Fehler;<250us;<500us;<1ms;<2ms;<4ms;<8ms;<16ms;>=16ms");
+  for (int i = 0; i < P_COUNT; i++) {
+    out.print("Befehl ");
+    out.print(profileCommandToStr((ProfileCommand)i));
+    out.print(";");
+    printProfileStats(out, profileCommands[i]);
+  }
+  for (int i = 0; i < profileBusCount; i++) {
+    if (profileBuses[i].count == 0) {
+      continue;
+    }
+    out.print("Bus ");
+    out.print(i);
+    out.print(";");
+    printProfileStats(out, profileBuses[i]);
+  }
+  for (int i = 0; i < profileDeviceCount; i++) {
+    if (!profileDevices[i].used) {
+      continue;
+    }
+    out.print("Geraet ");
+    for (uint8_t j = 0; j < 8; j++) {
+      if (profileDevices[i].address[j] < 16) out.print("0");
+      out.print(profileDevices[i].address[j], HEX);
+    }
+    out.print(" Bus ");
+    out.print(profileDevices[i].bus);
+    out.print(";");
+    printProfileStats(out, profileDevices[i].stats);
+  }
+}
+
+void resetProfile() {
+  for (int i = 0; i < P_COUNT; i++) {
+    profileCommands[i] = ProfileStats();
+  }
+  for (int i = 0; i < profileBusCount; i++) {
+    profileBuses[i] = ProfileStats();
+  }
+  for (int i = 0; i < profileDeviceCount; i++) {
+    profileDevices[i] = ProfileDevice();
+  }
+}
+
+#else
+
+// Ohne PROFILER bleiben nur leere Funktionen, die Aufrufstellen kosten so keine Rechenzeit
+unsigned long profileStart() {
+  return 0;
+}
+
+void profileEnd(const unsigned long start, const ProfileCommand command, const uint8_t *device, const uint8_t bus, const ProfileResult result) {
+}
+
+void printProfile(Print &out) {
+  out.println("Profiler nicht aktiv, in main.cpp #define PROFILER setzen");
+}
+
+void resetProfile() {
+}
+
+#endif
+
+const char* profileCommandToStr(const ProfileCommand command) {
+  switch (command) {
+    case P_CONVERT_T:       return "Convert T";
+    case P_CONVERT_V:       return "Convert V";
+    case P_READ_SCRATCHPAD: return "Read Scratchpad";
+    case P_SELECT_CHANNEL:  return "Select Channel";
+    case P_READ_PAGE:       return "Read Page";
+    case P_ALARM_SEARCH:    return "Alarm Search";
+    case P_SEARCH:          return "Search";
+    default:                return "unbekannt";
+  }
+}
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <DallasTemperature.h>
+#include <DS2438.h>
 
 typedef char  SensorAddress           [17];
 typedef char  SensorName              [21];
@@ -9,15 +10,117 @@ typedef float SensorValueMin;
 typedef float SensorValueMax;
 typedef float SensorValueFormatMin;
 typedef float SensorValueFormatMax;
+typedef uint8_t SensorChannels;
+typedef uint8_t SensorResolution;
+typedef int8_t  SensorAlarm;
+typedef uint64_t SensorRom;                   // ROM-Code als 64-Bit-Schlüssel, Familien-Code im höchsten Byte
+typedef int32_t SensorRaw;                    // Messwert als Ganzzahl in der Einheit des Sensors, siehe SensorUnit
 
-typedef enum {
+const SensorAlarm sensorAlarmLowOff   = -55;  // TL, bei dem ein DS18B20 im Messbereich nie Alarm meldet
+const SensorAlarm sensorAlarmHighOff  = 125;  // TH, bei dem ein DS18B20 im Messbereich nie Alarm meldet
+
+typedef enum : uint8_t {
 	T_DS18B20 = 't',
   T_DS18S20 = 't',
   T_DS1822  = 't',
   T_DS2438  = 'b',
+  T_VIRTUAL = 'v',   // Abgeleiteter Sensor, siehe virtualsensors.h
   T_UNKNOWN = 'u'
 } SensorType;
 
+const uint8_t virtualSensorFamily = 0x00; // Familien-Code der Adressen abgeleiteter Sensoren, kein 1-Wire-Gerät hat ihn
+
+// Einheit eines SensorRaw, der Wert gibt den Teiler zur physikalischen Größe an (raw / unit = °C bzw. V)
+typedef enum : uint16_t {
+  U_TEMPERATURE     = 16,   // 1/16 °C, so liefert ihn ein DS18B20
+  U_VOLTAGE         = 100,  // 10 mV, so liefert ihn ein DS2438
+  U_MILLI           = 1000, // 1/1000, Ergebnis eines abgeleiteten Sensors
+  U_TEMPERATURE_FINE = 32   // 1/32 °C, so liefert ihn ein DS2438, nur als Eingang eines abgeleiteten Sensors
+} SensorUnit;
+
+const int sensorDecimalsMax = 4;  // Höchstens unterstützte Dezimalstellen (precision) der Anzeige
+const int sensorWidthMax    = 16; // Höchstens unterstützte Feldbreite im Format-String, z.B. "%5s"
+const int sensorDisplaySize = 32; // Puffergröße, in die jeder Anzeige-Wert passt: Literale, Feldbreite und Zahl
+
+typedef enum : uint8_t {
+  F_DIRECT          = 0,  // Messwert direkt anzeigen
+  F_PERCENT         = 1,  // Messwert im Bereich min bis max als Prozentwert
+  F_PROPORTIONAL    = 2,  // Messwert im Bereich min bis max als anteiliger Wert von formatMin bis formatMax
+  F_TABLE           = 3   // Messwert per Kalibrier-Tabelle, z.B. Liter eines nicht quaderförmigen Tanks
+} SensorFormatMode;
+
+/*
+    Kalibrier-Tabelle für Sensoren, deren Anzeige-Wert nicht linear vom Messwert abhängt. Zwischen zwei Punkten 
+    wird linear interpoliert, außerhalb gilt der nächste Endpunkt. Gespeichert wird sie wie eingegeben 
+    (SensorCalibration), zum Rechnen wird sie per compileCalibration() in Ganzzahlen übersetzt (CompiledCalibration).
+*/
+const int calibrationPointCount = 8;    // Gibt an, wie viele Punkte eine Kalibrier-Tabelle höchstens hat
+const int calibrationTextSize   = 160;  // Puffergröße für eine Tabelle als Text, siehe calibrationToStr()
+
+struct CalibrationPoint {
+  float                 input;                        // Messwert in °C bzw. V
+  float                 output;                       // Anzeige-Wert, z.B. Liter
+};
+
+struct SensorCalibration {
+  DeviceAddress         address;                      // Sensor, zu dem die Tabelle gehört
+  uint8_t               count           = 0;          // Anzahl der Punkte, nach input aufsteigend sortiert
+  CalibrationPoint      points[calibrationPointCount];
+};
+
+/*
+    Multiplikator als 31-Bit-Mantisse mit eigener Zahl an Nachkommabits, siehe toFixedScale(). Feste 16 Nachkommabits 
+    reichen für kleine Faktoren nicht: 1/1000 (U_MILLI) wird zu 66/65536 und jeder Wert 0,7 % zu groß.
+*/
+struct FixedScale {
+  int32_t               mul             = 0;
+  int8_t                shift           = 16;         // Nachkommabits von mul
+};
+
+struct CompiledCalibration {
+  uint8_t               count           = 0;          // Anzahl der Punkte, mindestens 2
+  SensorRaw             input[calibrationPointCount]; // Messwerte in der Einheit des Sensors, streng aufsteigend
+  int32_t               output[calibrationPointCount];// Anzeige-Werte in 10^-decimals
+  FixedScale            slope[calibrationPointCount]; // Steigung zum nächsten Punkt
+};
+
+/*
+    Aus der Config übersetzter Formatierer, siehe compileSensorFormatter(). sensorValueToDisplay() rechnet damit 
+    nur noch und kopiert Text, Config und Format-String werden dabei nicht mehr ausgewertet.
+    Der Anzeige-Wert ist eine Ganzzahl in 10^-decimals, z.B. 1234 bei decimals = 2 für "12.34". Multiplikatoren sind 
+    FixedScale, Offsets Festkommazahlen mit 16 Nachkommabits, so braucht die Umrechnung weder float noch eine Division.
+    Der Format-String liegt als Literal ohne den Platzhalter vor ("%%" schon zu "%" aufgelöst), der Wert wird an 
+    valuePos eingefügt.
+*/
+struct SensorFormatter {
+  FixedScale            directScale;                  // Direkte Anzeige: raw * directScale
+  FixedScale            rangeScale;                   // Prozent- oder anteilige Anzeige: raw * rangeScale + rangeOffset
+  int64_t               rangeOffset     = 0;
+  SensorRaw             rawMin          = 0;          // min als SensorRaw, außerhalb von rawMin bis rawMax wird direkt angezeigt
+  SensorRaw             rawMax          = -1;
+  const CompiledCalibration *calibration = nullptr;   // Nur F_TABLE: Übersetzte Kalibrier-Tabelle
+  SensorFormatMode      mode            = F_DIRECT;
+  uint8_t               decimals        = 0;          // Dezimalstellen, precision begrenzt auf 0 bis sensorDecimalsMax
+  SensorValueFormat     literal         = "";         // Präfix und Suffix des Format-Strings
+  int8_t                valuePos        = -1;         // Position des Wertes im Literal, -1 = Format ohne "%s"
+  int8_t                width           = 0;          // Feldbreite aus "%5s", negativ für linksbündig ("%-5s")
+};
+
+typedef enum : uint8_t {
+  S_OK              = 0,  // Wert erfolgreich gelesen
+  S_NO_PRESENCE     = 1,  // Kein Gerät hat auf den Reset geantwortet
+  S_CRC_ERROR       = 2,  // Prüfsumme des Scratchpads stimmt nicht
+  S_BUS_ERROR       = 3,  // Scratchpad besteht nur aus Nullen, z.B. Kurzschluss auf dem Bus
+  S_POWER_ON_VALUE  = 4,  // Einschaltwert 85 °C samt Einschalt-Zustand des Scratchpads, der Sensor hat keine Wandlung durchgeführt
+  S_INVALID_VALUE   = 5   // Nur abgeleitete Sensoren: Ausdruck nicht berechenbar, z.B. Division durch 0
+} SensorStatus;
+
+typedef enum : uint8_t {
+  H_OK              = 0,  // Letzte Abfrage erfolgreich
+  H_DEGRADED        = 1,  // Abfragen schlagen fehl, der Sensor wird mit wachsendem Abstand erneut versucht
+  H_QUARANTINED     = 2   // Dauerhaft fehlerhaft, der Sensor wird nur noch im Abstand von sensorQuarantineInterval geprüft
+} SensorHealth;
+
 struct SensorConfig {
   SensorName            name            = "";        // Name zur Anzeige
   SensorValueFormat     format          = "%s";      // Format-String zur Darstellung des Wertes
@@ -26,32 +129,150 @@ struct SensorConfig {
   SensorValuePrecision  precision       = 0;         // Dezimalstellen des Wertes
   SensorValueMin        min             = -1;        // Minimum des Messwertes 
   SensorValueMax        max             = -1;        // Minimum des Messwertes
+  SensorChannels        channels        = DS2438_MODE_CHA; // Nur DS2438: Zu wandelnde Messwerte (DS2438_MODE_*), der erste von Kanal A, Kanal B, Temperatur wird zum Wert
+  SensorResolution      resolution      = 12;        // Nur DS18B20: Auflösung in Bit (9 bis 12), bestimmt die Wandlungszeit (94 bis 750 ms)
+  SensorAlarm           alarmLow        = sensorAlarmLowOff;  // Nur DS18B20: Untere Alarm-Schwelle (TL) in ganzen °C
+  SensorAlarm           alarmHigh       = sensorAlarmHighOff; // Nur DS18B20: Obere Alarm-Schwelle (TH) in ganzen °C
 };
 
+// Eintrag der früheren Konfig mit festen Feldern, wird nur noch zum Übernehmen einer alten Konfig gebraucht
 struct PersistantSensorConfig {
   SensorAddress         address         = "";        // Addresse des zu konfigurierenden Sensors
   SensorConfig          config;                      // Anzuwendende Konfig
 };
 
+/*
+    Kompakter Konfig-Eintrag im Flash, variable Länge:
+    8 Bytes ROM-Code, 1 Byte Feld-Maske (SR_*), danach nur die Felder, die vom Standard in SensorConfig abweichen,
+    in der Reihenfolge der Bits. Format-Strings stehen nur einmal in einer gemeinsamen Liste, der Eintrag hält 
+    ihren Index. Ein Sensor mit Standardwerten belegt so 9 Bytes, mit Namen ca. 20 statt 76 Bytes.
+*/
+const uint8_t SR_NAME         = 0x01;   // 1 Byte Länge, dann die Zeichen ohne '\0'
+const uint8_t SR_FORMAT       = 0x02;   // 1 Byte Index in die Format-Strings
+const uint8_t SR_FORMAT_RANGE = 0x04;   // formatMin und formatMax, je 4 Bytes
+const uint8_t SR_VALUE_RANGE  = 0x08;   // min und max, je 4 Bytes
+const uint8_t SR_PRECISION    = 0x10;   // 1 Byte
+const uint8_t SR_CHANNELS     = 0x20;   // 1 Byte
+const uint8_t SR_RESOLUTION   = 0x40;   // 1 Byte
+const uint8_t SR_ALARM        = 0x80;   // alarmLow und alarmHigh, je 1 Byte
+
+/*
+    Die Felder sind nach Größe sortiert, die 1-Byte-Felder füllen die Lücke hinter den Adressen. So kommt ein Sensor 
+    mit wenigen Füllbytes auf 176 Bytes, siehe sensorCapacity.
+*/
 struct Sensor {
   SensorAddress         address         = "";         // Adresse des Sensors userfriendly
   DeviceAddress         deviceAddress;                // Adresse des Sensors als HEX
   SensorType            type            = T_UNKNOWN;  // Typ, derzeit werden nur t, b und u unterstützt
+  SensorStatus          status          = S_OK;       // Ergebnis der letzten Abfrage
+  SensorHealth          health          = H_OK;       // Zustand über mehrere Abfragen, bestimmt Backoff und Quarantäne
+  uint8_t               failures        = 0;          // Anzahl der fehlgeschlagenen Abfragen in Folge
+  int8_t                probe           = -1;         // Nur DS2438: Index des Treibers in ds2438Pool, -1 = keiner
+  uint8_t               bus             = 0;          // Index des 1-Wire-Busses in buses[], an dem der Sensor hängt
+  SensorUnit            unit            = U_TEMPERATURE; // Einheit von raw, folgt aus Typ und channels
   SensorConfig          config;
-  float                 value;
+  SensorRaw             raw             = 0;          // Letzter Messwert in der Einheit unit
+  SensorFormatter       formatter;                    // Aus config übersetzt, siehe compileSensorFormatter()
+  unsigned long         interval        = 0;          // Aktuelles Abfrage-Intervall in Millisekunden, wird vom Scheduler angepasst
+  unsigned long         nextDue         = 0;          // Zeitpunkt (millis()), ab dem der Sensor wieder abgefragt wird
+  SensorRaw             lastRaw         = 0;          // Wert bei der letzten Planung, zur Erkennung von Änderungen
+  boolean               due             = false;      // Sensor ist fällig und wird in der laufenden Abfrage gelesen
+  boolean               seen            = false;      // Sensor wurde im laufenden Suchlauf der Bus-Erkennung gefunden
+  uint8_t               missed          = 0;          // Anzahl der Suchläufe in Folge, in denen der Sensor fehlte
+  boolean               alarmArmed      = false;      // Nur DS18B20: Sensor hat ein Alarm-Band und einen gültigen Wert, er wird nur noch bei Alarm gelesen
+  boolean               alarmHit        = false;      // Nur DS18B20: Sensor wurde von der Alarm-Suche der laufenden Abfrage gemeldet
+  boolean               used            = false;      // Platz in sensors.sensorList ist belegt
+};
+
+/*
+    Gibt an, wie viele Sensoren die Liste fasst, anpassbar z.B. per build_flags = -D SENSOR_CAPACITY=32 in der 
+    platformio.ini. RAM je Platz auf dem SAMD21:
+      Sensor                                              176 Bytes
+      Momentaufnahme, zwei Puffer je 40 Bytes              80 Bytes
+      romIndex 16, freeSlots 2, Planung 2 x 2 je Bus       26 Bytes (bei 2 Bussen)
+      Geräte-Cache (Topology)                              13 Bytes
+    zusammen ca. 300 Bytes, bei 64 Sensoren ca. 19 KB. Mit Konfig (ca. 1 KB), Kalibrier-Tabellen, DS2438-Treibern, 
+    WiFi, MQTT und Stack bleiben von den 32 KB nur wenige KB frei, mehr als 64 Plätze passen nur mit weniger Bussen 
+    oder kleineren Pools.
+*/
+#ifndef SENSOR_CAPACITY
+#define SENSOR_CAPACITY 64
+#endif
+const int sensorCapacity = SENSOR_CAPACITY;
+
+const int sensorScheduleSize = sensorCapacity;  // Gibt an, wie viele Sensoren je Abfrage-Art eingeplant werden können
+
+struct SensorSchedule {
+  int16_t               entries[sensorScheduleSize];  // Indizes in sensors.sensorList, als Min-Heap nach nextDue geordnet
+  int                   count           = 0;          // Anzahl eingeplanter Sensoren
+};
+
+const int sensorIndexSize = sensorCapacity;   // Gibt an, wie viele Sensoren über ihren ROM-Code gefunden werden können
+
+struct SensorIndexEntry {
+  SensorRom             rom;                          // Schlüssel, siehe deviceAddressToRom()
+  int                   index;                        // Index in sensorList
 };
 
+/*
+    Feste Plätze statt eines bei jeder Änderung neu angelegten Arrays: Ein Sensor behält seinen Index vom Hinzufügen 
+    bis zum Entfernen, Planung, Index und Streaming müssen daher nichts nachführen. Freie Plätze liegen auf einem 
+    Stapel (freeSlots), einen Platz zu belegen oder freizugeben kostet so O(1) und fragmentiert den Heap nicht. 
+    Das Einsortieren in romIndex verschiebt dagegen Einträge (O(n)), removeSensor() baut zudem die Planung neu auf.
+    Schleifen laufen bis slots und überspringen Plätze mit used == false.
+*/
 struct Sensors {
-  Sensor*               sensorList      = nullptr;    // Zeiger auf das Array von SensorData
+  Sensor                sensorList[sensorCapacity];   // Plätze der Sensoren
   int                   count           = 0;          // Aktuelle Anzahl von Sensoren
+  int                   slots           = 0;          // Anzahl der bisher genutzten Plätze, obere Grenze aller Schleifen
+  int16_t               freeSlots[sensorCapacity];    // Stapel der wieder freigegebenen Plätze unterhalb von slots
+  int                   freeCount       = 0;          // Anzahl der Einträge in freeSlots
+  SensorIndexEntry      romIndex[sensorIndexSize];    // Nach rom aufsteigend sortiert, für die binäre Suche in findSensor()
+  int                   indexCount      = 0;          // Anzahl der Einträge in romIndex
+};
+
+/*
+    Momentaufnahme der Sensoren für Anzeige, HTTP und MQTT, siehe publishSnapshot() in main.cpp. Die Erfassung 
+    schreibt in den hinteren Puffer und tauscht ihn danach gegen den vorderen, die Leser sehen so immer einen in sich 
+    stimmigen Stand mit fertig formatierten Werten. version steigt mit jedem Tausch, ein Leser, der sich die zuletzt 
+    verarbeitete Version merkt, spart sich die Arbeit, solange sie gleich bleibt.
+    Ein Platz hält nur, was die Leser sonst selbst erzeugen müssten, sowie die Felder zur Erkennung von Änderungen. 
+    Name, Adresse und Bus lesen die Leser über slot direkt aus sensors.sensorList. Jeder Platz belegt je Puffer 
+    ca. 40 Bytes RAM.
+*/
+struct SensorView {
+  char                  display[sensorDisplaySize];   // Formatierter Wert, siehe sensorValueToDisplay()
+  SensorRaw             raw;                          // raw des Sensors zum Zeitpunkt der Aufnahme, zur Erkennung von Änderungen
+  SensorHealth          health;
+  uint8_t               failures;
+  int16_t               slot;                         // Index des Sensors in sensors.sensorList
+};
+
+struct SensorSnapshot {
+  SensorView            views[sensorCapacity];        // Nur die belegten Plätze, in der Reihenfolge von sensorList
+  int                   count           = 0;          // Anzahl der Einträge in views
+  uint32_t              version         = 0;          // Stand der Aufnahme, 0 = noch nie veröffentlicht
+};
+
+// Tabellen für die Umwandlung zwischen ROM-Code und Hex-String, ohne String-Objekte und strtol()
+const char    hexEncodeTable[]                = "0123456789ABCDEF";
+const int8_t  hexDecodeTable['f' - '0' + 1]   = {
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,   // '0' bis '?'
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,   // '@' bis 'O'
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,   // 'P' bis '_'
+  -1, 10, 11, 12, 13, 14, 15                                         // '`' bis 'f'
 };
 
 
 /* 
     Die Logik zur Anzeige ist wie folgt: 
 
+    Der Messwert steht als Ganzzahl in der Einheit des Sensors in => raw (z.B. 150 in 10 mV für 1,5 V). Die folgende 
+    Umrechnung wird beim Hinzufügen des Sensors einmalig per compileSensorFormatter() in Festkomma-Faktoren und die
+    Literale des Format-Strings übersetzt, erst sensorValueToDisplay() erzeugt daraus Text.
+
     * Direkt Anzeige
-    Der Wert des Sensors wird ermittelt und steht in => value (z.B.  1,5)
+    Der Wert des Sensors wird ermittelt und steht in => raw / unit (z.B.  1,5)
     Der Wert kann nun direkt ausgegeben werden (Standard).
     Beispiel
     format ="%s C" / precision = 1  (Implizit: formatMin = -1 / formatMax = -1 / min = -1 / max = -1)
@@ -74,53 +295,400 @@ struct Sensors {
 */
 
 // *************** Deklaration der Funktionen
-byte convertHexCStringToByte(const char* hexString);
-String deviceAddressToStr(DeviceAddress addr);
-void deviceAddressToStrNew(const DeviceAddress addr, String out);
-const char* deviceAddressToChar(DeviceAddress addr); 
-bool strToDeviceAddress(const String &str, DeviceAddress &addr);
-bool getSensorTypeByAddress(const SensorAddress manufacturerCode, SensorType &sensorType);
+int hexDigitValue(const char c);
+void deviceAddressToHex(const DeviceAddress addr, SensorAddress out);
+bool hexToDeviceAddress(const char* hex, DeviceAddress addr);
+SensorRom deviceAddressToRom(const DeviceAddress addr);
+bool isConfigAddressOf(const DeviceAddress configAddr, const DeviceAddress addr);
+bool getSensorTypeByFamily(const uint8_t family, SensorType &sensorType);
 void copyDeviceAddress(const DeviceAddress in, DeviceAddress out);
 void sensorValueToDisplay(const float sensorValue, const SensorValueFormat formatString, const SensorValueFormatMin formatMin, const SensorValueFormatMax formatMax, const SensorValuePrecision precision, const SensorValueMin min, const SensorValueMax max, char displayValue[30]);
-void sensorValueToDisplay(const Sensor sensor, char displayValue[30]);
+int sensorValueToDisplay(const Sensor &sensor, char *displayValue, const int size);
+SensorUnit getSensorUnit(const SensorType type, const SensorChannels channels);
+int64_t toFixed16(const double value);
+FixedScale toFixedScale(const double value);
+int64_t applyFixedScale(const int64_t value, const FixedScale scale);
+void compileSensorFormatter(Sensor &sensor);
+void compileSensorFormat(const char *format, SensorFormatter &formatter);
+int32_t scaleSensorValue(const Sensor &sensor);
+void compileCalibration(Sensor &sensor, const SensorCalibration &calibration, CompiledCalibration &compiled);
+int32_t interpolateCalibration(const CompiledCalibration &compiled, const SensorRaw raw);
+boolean strToCalibration(const char* input, SensorCalibration &calibration);
+void calibrationToStr(const SensorCalibration &calibration, char output[calibrationTextSize]);
+int32_t rawToHundredths(const SensorRaw raw, const SensorUnit unit);
+const char* sensorLabel(const Sensor &sensor);
+void fillSensorView(const Sensor &sensor, const int slot, SensorView &view);
+boolean isSensorViewCurrent(const SensorView &view, const Sensor &sensor, const int slot);
+int formatFixed(const int32_t value, const uint8_t decimals, char *out, const int size);
+void channelsToStr(const SensorChannels channels, char output[4]);
+SensorChannels strToChannels(const char* input);
+SensorStatus decodeTemperatureScratchPad(const uint8_t family, const uint8_t *scratchPad, int16_t &raw);
+const char* sensorStatusToStr(const SensorStatus status);
+const char* sensorHealthToStr(const SensorHealth health);
+boolean hasAlarmBand(const SensorConfig &config);
+int internFormat(char *pool, const int poolSize, const char *format);
+const char* getInternedFormat(const char *pool, const int poolSize, const int index);
+int encodeSensorRecord(const DeviceAddress addr, const SensorConfig &config, const int formatIndex, uint8_t *out, const int space);
+int decodeSensorRecord(const uint8_t *in, const int length, DeviceAddress addr, SensorConfig &config, int &formatIndex);
+SensorAlarm strToAlarm(const char* input, const SensorAlarm off);
 
 // ***************  Funktionen
-void sensorValueToDisplay(const Sensor sensor, char displayValue[30]) {
-    char stringBuffer[30] = "";
-  float calcedValue = -1;
-  Serial.println("sensorValueToDisplay() begin");
+int sensorValueToDisplay(const Sensor &sensor, char *displayValue, const int size) {
+  /*
+    Schreibt den Anzeige-Wert per übersetztem Formatierer direkt nach displayValue. Gibt die Länge ohne '\0' zurück,
+    0 wenn displayValue mit size Bytes zu klein ist, displayValue ist dann leer.
+    sensorDisplaySize reicht für jeden Sensor.
+  */
+  const SensorFormatter &formatter = sensor.formatter;
+  char  value[16];
+  int   valueLength   = 0;
+  int   padding       = 0;
+  int   literalLength = strlen(formatter.literal);
+  int   prefixLength  = formatter.valuePos < 0 ? literalLength : formatter.valuePos;
+  int   length;
 
-  // Wenn min oder max nicht gesetzt sind
-  if (sensor.config.min < 0 || sensor.config.max < 0) {
-    // Erfolgt keine Umrechnung, sondern die Übernahme des float Wertes
-    Serial.println("  Keine Umrechnung, direkte Anzeige");
-    calcedValue = sensor.value;
+  if (formatter.valuePos >= 0) {
+    valueLength = formatFixed(scaleSensorValue(sensor), formatter.decimals, value, sizeof(value));
+    padding     = max(0, abs(formatter.width) - valueLength);
+  }
+  length = literalLength + padding + valueLength;
+  if (length + 1 > size) {
+    if (size > 0) {
+      displayValue[0] = '\0';
+    }
+    return 0;
+  }
+
+  memcpy(displayValue, formatter.literal, prefixLength);
+  length = prefixLength;
+  if (formatter.width > 0) {
+    memset(&displayValue[length], ' ', padding);
+    length += padding;
+  }
+  memcpy(&displayValue[length], value, valueLength);
+  length += valueLength;
+  if (formatter.width < 0) {
+    memset(&displayValue[length], ' ', padding);
+    length += padding;
+  }
+  strcpy(&displayValue[length], &formatter.literal[prefixLength]);
+  return length + literalLength - prefixLength;
+}
+
+SensorUnit getSensorUnit(const SensorType type, const SensorChannels channels) {
+  // Ein DS2438 liefert eine Spannung, außer es ist nur die Temperatur konfiguriert
+  if (type == T_VIRTUAL) {
+    return U_MILLI;
+  }
+  if (type == T_DS2438 && (channels & (DS2438_MODE_CHA | DS2438_MODE_CHB))) {
+    return U_VOLTAGE;
+  }
+  return U_TEMPERATURE;
+}
+
+int64_t toFixed16(const double value) {
+  return (int64_t)floor(value * 65536.0 + 0.5);
+}
+
+FixedScale toFixedScale(const double value) {
+  // So viele Nachkommabits wie möglich, |mul| bleibt unter 2^30: relative Genauigkeit ca. 2^-30 für jeden Faktor
+  FixedScale  scale;
+  int         exponent;
+
+  frexp(value, &exponent);
+  scale.shift = constrain(30 - exponent, 0, 62);
+  scale.mul   = (int32_t)constrain(llround(ldexp(value, scale.shift)), (long long)-INT32_MAX, (long long)INT32_MAX);
+  return scale;
+}
+
+int64_t applyFixedScale(const int64_t value, const FixedScale scale) {
+  // value * scale als Festkommazahl mit 16 Nachkommabits
+  int64_t product = value * scale.mul;
+
+  return scale.shift >= 16 ? product >> (scale.shift - 16) : product << (16 - scale.shift);
+}
+
+void compileSensorFormatter(Sensor &sensor) {
+  // Übersetzt Umrechnung und Format-String aus der Config einmalig, nur hier wird noch mit double gerechnet
+  const SensorConfig  &config     = sensor.config;
+  SensorFormatter     &formatter  = sensor.formatter;
+  double              factor;
+  double              offset;
+  double              pow10       = 1;
+
+  sensor.unit = getSensorUnit(sensor.type, config.channels);
+  formatter = SensorFormatter();
+  compileSensorFormat(config.format, formatter);
+  formatter.decimals = constrain(config.precision, 0, sensorDecimalsMax);
+  for (int i = 0; i < formatter.decimals; i++) {
+    pow10 *= 10;
+  }
+  formatter.directScale = toFixedScale(pow10 / sensor.unit);
+
+  // Ohne min und max oder mit leerem Bereich bleibt es bei der direkten Anzeige
+  if (config.min < 0 || config.max < 0 || config.max <= config.min) {
+    return;
+  }
+  formatter.rawMin = (SensorRaw)ceil(config.min * sensor.unit);
+  formatter.rawMax = (SensorRaw)floor(config.max * sensor.unit);
+  if (config.formatMin < 0 || config.formatMax < 0) {
+    // Prozentwert: (value - min) / (max - min) * 100
+    formatter.mode = F_PERCENT;
+    factor = 100.0 / (config.max - config.min);
+    offset = -config.min * factor;
   } else {
-    // Plausi-Prüfung
-    if (sensor.value >= sensor.config.min && sensor.value <= sensor.config.max && sensor.config.max > sensor.config.min) {
-      if (sensor.config.formatMin < 0 || sensor.config.formatMax < 0) {
-        Serial.println("  Umrechnung in Prozentwert");
-        calcedValue = (sensor.value - sensor.config.min) / (sensor.config.max - sensor.config.min) * 100;
-      } else {
-        Serial.println("  Umrechnung in anteiligen Wert");
-        calcedValue = ((sensor.config.formatMax - sensor.config.formatMin) * (sensor.value - sensor.config.min) / (sensor.config.max - sensor.config.min)) + sensor.config.formatMin;
+    // Anteiliger Wert: (formatMax - formatMin) * (value - min) / (max - min) + formatMin
+    formatter.mode = F_PROPORTIONAL;
+    factor = (config.formatMax - config.formatMin) / (config.max - config.min);
+    offset = config.formatMin - config.min * factor;
+  }
+  formatter.rangeScale  = toFixedScale(factor * pow10 / sensor.unit);
+  formatter.rangeOffset = toFixed16(offset * pow10);
+}
+
+void compileSensorFormat(const char *format, SensorFormatter &formatter) {
+  /*
+    Zerlegt den Format-String in Literal und Platzhalter. Unterstützt werden wie bisher "%%" und ein "%s", 
+    auch mit Feldbreite ("%5s", "%-5s"). Alles andere, auch ein zweites "%s", bleibt Text, statt wie bei sprintf() 
+    ungültigen Speicher zu lesen.
+  */
+  int     length = 0;
+  int     j;
+  int     width;
+  boolean left;
+
+  formatter.valuePos  = -1;
+  formatter.width     = 0;
+  for (int i = 0; format[i] != '\0' && length < (int)sizeof(SensorValueFormat) - 1; i++) {
+    if (format[i] == '%' && format[i + 1] == '%') {
+      formatter.literal[length++] = '%';
+      i++;
+      continue;
+    }
+    if (format[i] == '%' && formatter.valuePos < 0) {
+      j     = i + 1;
+      width = 0;
+      left  = format[j] == '-';
+      if (left) {
+        j++;
+      }
+      while (isdigit(format[j])) {
+        width = width * 10 + format[j++] - '0';
+      }
+      if (format[j] == 's') {
+        width               = min(width, sensorWidthMax);
+        formatter.valuePos  = length;
+        formatter.width     = left ? -width : width;
+        i = j;
+        continue;
       }
+    }
+    formatter.literal[length++] = format[i];
+  }
+  formatter.literal[length] = '\0';
+}
+
+int32_t scaleSensorValue(const Sensor &sensor) {
+  // Anzeige-Wert in 10^-decimals, die Addition von 0,5 (32768) vor dem Schieben rundet
+  const SensorFormatter &formatter = sensor.formatter;
+
+  if (formatter.mode == F_TABLE) {
+    return interpolateCalibration(*formatter.calibration, sensor.raw);
+  }
+  if (formatter.mode != F_DIRECT && sensor.raw >= formatter.rawMin && sensor.raw <= formatter.rawMax) {
+    return (int32_t)((applyFixedScale(sensor.raw, formatter.rangeScale) + formatter.rangeOffset + 32768) >> 16);
+  }
+  // Außerhalb des Messbereichs ist keine Umrechnung möglich, angezeigt wird der Messwert selbst
+  return (int32_t)((applyFixedScale(sensor.raw, formatter.directScale) + 32768) >> 16);
+}
+
+void compileCalibration(Sensor &sensor, const SensorCalibration &calibration, CompiledCalibration &compiled) {
+  /*
+    Übersetzt die Tabelle in Messwerte der Einheit des Sensors und Anzeige-Werte in 10^-decimals und berechnet die 
+    Steigung jedes Abschnitts vorab. Je Messwert bleiben so eine binäre Suche und eine Multiplikation.
+    Muss nach compileSensorFormatter() aufgerufen werden, compiled muss so lange bestehen wie der Sensor.
+  */
+  double    pow10 = 1;
+  SensorRaw input;
+
+  for (int i = 0; i < sensor.formatter.decimals; i++) {
+    pow10 *= 10;
+  }
+  compiled.count = 0;
+  for (int i = 0; i < calibration.count && i < calibrationPointCount; i++) {
+    input = lround(calibration.points[i].input * sensor.unit);
+    // Punkte, die nach dem Runden nicht mehr aufsteigen, haben keine Steigung und entfallen
+    if (compiled.count > 0 && input <= compiled.input[compiled.count - 1]) {
+      continue;
+    }
+    compiled.input[compiled.count]  = input;
+    compiled.output[compiled.count] = lround(calibration.points[i].output * pow10);
+    compiled.count++;
+  }
+  if (compiled.count < 2) {
+    Serial.print("compileCalibration(): Zu wenige Punkte für Sensor ");
+    Serial.println(sensor.address);
+    return;
+  }
+  for (int i = 0; i < compiled.count - 1; i++) {
+    compiled.slope[i] = toFixedScale((double)(compiled.output[i + 1] - compiled.output[i]) / (compiled.input[i + 1] - compiled.input[i]));
+  }
+  sensor.formatter.mode         = F_TABLE;
+  sensor.formatter.calibration  = &compiled;
+}
+
+int32_t interpolateCalibration(const CompiledCalibration &compiled, const SensorRaw raw) {
+  // Außerhalb der Tabelle gilt der nächste Endpunkt, ein Tank wird nicht leerer als leer
+  int low   = 0;
+  int high  = compiled.count - 1;
+  int mid;
+
+  if (raw <= compiled.input[low]) {
+    return compiled.output[low];
+  }
+  if (raw >= compiled.input[high]) {
+    return compiled.output[high];
+  }
+  // Binäre Suche nach dem Abschnitt input[low] <= raw < input[high]
+  while (high - low > 1) {
+    mid = (low + high) >> 1;
+    if (compiled.input[mid] <= raw) {
+      low = mid;
     } else {
-      Serial.println("  Umrechnung nicht möglich");
-      calcedValue = sensor.value;
+      high = mid;
     }
   }
-  Serial.print("  dtostrf: calcedValue=");
-  Serial.print(calcedValue);
-  Serial.print(" precision=");
-  Serial.print(sensor.config.precision);
-  dtostrf(calcedValue, 0, sensor.config.precision, stringBuffer);
-  Serial.print("  stringBuffer: ");
-  Serial.println(stringBuffer);
-  sprintf(displayValue, sensor.config.format, stringBuffer);
-  Serial.print("  displayValue: ");
-  Serial.println(displayValue);
-  Serial.println("sensorValueToDisplay() end");
+  return compiled.output[low] + (int32_t)((applyFixedScale((int64_t)raw - compiled.input[low], compiled.slope[low]) + 32768) >> 16);
+}
+
+boolean strToCalibration(const char* input, SensorCalibration &calibration) {
+  /*
+    Liest eine Tabelle im Format "Messwert:Anzeige-Wert" je Punkt, getrennt durch Leerzeichen, z.B. "0.2:0 1.1:60 1.5:100".
+    Die Punkte werden nach dem Messwert sortiert. false bei einem leeren Feld, einem Fehler oder weniger als 2 Punkten.
+  */
+  const char*       pos = input;
+  char*             end;
+  CalibrationPoint  point;
+  int               j;
+
+  calibration.count = 0;
+  if (input == nullptr) {
+    return false;
+  }
+  while (*pos != '\0') {
+    if (*pos == ' ') {
+      pos++;
+      continue;
+    }
+    if (calibration.count >= calibrationPointCount) {
+      Serial.println("strToCalibration(): Zu viele Punkte, calibrationPointCount erhöhen");
+      return false;
+    }
+    point.input = strtod(pos, &end);
+    if (end == pos || *end != ':') {
+      return false;
+    }
+    pos = end + 1;
+    point.output = strtod(pos, &end);
+    if (end == pos) {
+      return false;
+    }
+    pos = end;
+    // Sortiere per Einfügen ein
+    for (j = calibration.count; j > 0 && calibration.points[j - 1].input > point.input; j--) {
+      calibration.points[j] = calibration.points[j - 1];
+    }
+    calibration.points[j] = point;
+    calibration.count++;
+  }
+  return calibration.count >= 2;
+}
+
+void calibrationToStr(const SensorCalibration &calibration, char output[calibrationTextSize]) {
+  // Gegenstück zu strToCalibration(), für die Konfig-Seite. Punkte, die nicht mehr in output passen, entfallen.
+  char number[48];
+  char point[100];
+  int  length = 0;
+
+  output[0] = '\0';
+  for (int i = 0; i < calibration.count && i < calibrationPointCount; i++) {
+    strcpy(point, i > 0 ? " " : "");
+    dtostrf(calibration.points[i].input, 0, 2, number);
+    strcat(point, number);
+    strcat(point, ":");
+    dtostrf(calibration.points[i].output, 0, 2, number);
+    strcat(point, number);
+    if (length + (int)strlen(point) >= calibrationTextSize) {
+      break;
+    }
+    strcpy(&output[length], point);
+    length += strlen(point);
+  }
+}
+
+int32_t rawToHundredths(const SensorRaw raw, const SensorUnit unit) {
+  // Messwert in 1/100 °C bzw. V, z.B. für MQTT. 100/16 = 25/4, so bleibt es bei Multiplikation und Schieben
+  if (unit == U_TEMPERATURE) {
+    return (raw * 25 + 2) >> 2;
+  }
+  if (unit == U_MILLI) {
+    return raw >= 0 ? (raw + 5) / 10 : (raw - 5) / 10;
+  }
+  return raw;
+}
+
+const char* sensorLabel(const Sensor &sensor) {
+  // Name aus der Konfig, sonst die Adresse
+  return sensor.config.name[0] != '\0' ? sensor.config.name : sensor.address;
+}
+
+void fillSensorView(const Sensor &sensor, const int slot, SensorView &view) {
+  // Formatiert den Sensor einmalig für alle Leser der Momentaufnahme
+  sensorValueToDisplay(sensor, view.display, sizeof(view.display));
+  view.raw        = sensor.raw;
+  view.health     = sensor.health;
+  view.failures   = sensor.failures;
+  view.slot       = slot;
+}
+
+boolean isSensorViewCurrent(const SensorView &view, const Sensor &sensor, const int slot) {
+  // Vergleicht nur, was die Erfassung ändert. Name und Format ändern sich nur mit dem Formatierer, siehe snapshotStale.
+  return view.slot == slot && view.raw == sensor.raw && view.health == sensor.health && view.failures == sensor.failures;
+}
+
+int formatFixed(const int32_t value, const uint8_t decimals, char *out, const int size) {
+  /*
+    Schreibt einen Festkomma-Wert in 10^-decimals als Dezimalzahl, z.B. -1234 mit decimals = 2 als "-12.34".
+    Ersetzt dtostrf(), gibt die Länge ohne '\0' zurück, 0 wenn out zu klein ist.
+  */
+  char      digits[12];
+  int       count     = 0;
+  int       length    = 0;
+  uint32_t  magnitude = value < 0 ? 0 - (uint32_t)value : (uint32_t)value;
+
+  // Ziffern von hinten, mindestens eine vor dem Komma
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0 || count <= decimals);
+
+  if (size < count + (value < 0 ? 1 : 0) + (decimals > 0 ? 1 : 0) + 1) {
+    if (size > 0) {
+      out[0] = '\0';
+    }
+    return 0;
+  }
+  if (value < 0) {
+    out[length++] = '-';
+  }
+  while (count > 0) {
+    if (count == decimals) {
+      out[length++] = '.';
+    }
+    out[length++] = digits[--count];
+  }
+  out[length] = '\0';
+  return length;
 }
 
 [[deprecated("Diese Funktion wird eigentlich nicht mehr gebraucht, da es eine Version gibt, die eine Sensor-Struct annimmt")]]
@@ -163,20 +731,94 @@ void sensorValueToDisplay(const float sensorValue, const SensorValueFormat forma
 }
 
 
-byte convertHexCStringToByte(const char* hexString) {
-  // Erstelle einen temporären C-String mit den ersten beiden Zeichen des Eingabe-C-Strings
-  char tempString[3];
-  strncpy(tempString, hexString, 2);
-  // Stelle sicher, dass der temporäre C-String mit einem Null-Byte abgeschlossen ist
-  tempString[2] = '\0';
+void channelsToStr(const SensorChannels channels, char output[4]) {
+  // Die Kanäle werden als Buchstaben dargestellt: A = Kanal A, B = Kanal B, T = Temperatur
+  int i = 0;
+  if (channels & DS2438_MODE_CHA)         output[i++] = 'A';
+  if (channels & DS2438_MODE_CHB)         output[i++] = 'B';
+  if (channels & DS2438_MODE_TEMPERATURE) output[i++] = 'T';
+  output[i] = '\0';
+}
+
+SensorChannels strToChannels(const char* input) {
+  SensorChannels channels = 0;
+  for (size_t i = 0; input != nullptr && i < strlen(input); i++) {
+    switch (toupper(input[i])) {
+      case 'A': channels |= DS2438_MODE_CHA;         break;
+      case 'B': channels |= DS2438_MODE_CHB;         break;
+      case 'T': channels |= DS2438_MODE_TEMPERATURE; break;
+    }
+  }
+  // Ohne gültige Angabe wird wie bisher Kanal A verwendet
+  if (channels == 0) {
+    channels = DS2438_MODE_CHA;
+  }
+  return channels;
+}
+
+SensorStatus decodeTemperatureScratchPad(const uint8_t family, const uint8_t *scratchPad, int16_t &raw) {
+  // Ermittelt aus dem Scratchpad eines DS18B20/DS18S20/DS1822 die Temperatur in 1/16 °C
+  boolean allZero = true;
+  for (int i = 0; i < 9; i++) {
+    if (scratchPad[i] != 0) {
+      allZero = false;
+    }
+  }
+  // Ein Scratchpad aus Nullen hat eine gültige Prüfsumme, muss also vorher erkannt werden
+  if (allZero) {
+    return S_BUS_ERROR;
+  }
+  if (OneWire::crc8(scratchPad, 8) != scratchPad[8]) {
+    return S_CRC_ERROR;
+  }
+
+  raw = (((int16_t)scratchPad[1]) << 8) | scratchPad[0];
+  if (family == DS18S20MODEL) {
+    // Der DS18S20 liefert 0,5 °C Schritte, die über COUNT_REMAIN/COUNT_PER_C verfeinert werden
+    if (scratchPad[7] == 0) {
+      return S_CRC_ERROR;
+    }
+    raw = (raw & 0xFFFE) * 8 - 4 + ((scratchPad[7] - scratchPad[6]) * 16) / scratchPad[7];
+  } else {
+    // Bei geringerer Auflösung sind die unteren Bits undefiniert
+    int resolution = ((scratchPad[4] >> 5) & 0x03) + 9;
+    raw = raw & ~((1 << (12 - resolution)) - 1);
+    // 85 °C kann auch echt gemessen sein. Nach einer Wandlung setzt der DS18B20 Byte 6 auf 0x10 - (raw & 0x0F), 
+    // also 0x10 bei 85 °C, nur nach dem Einschalten steht dort noch 0x0C.
+    if (raw == 0x0550 && scratchPad[6] == 0x0C) {
+      return S_POWER_ON_VALUE;
+    }
+  }
+  return S_OK;
+}
+
+const char* sensorStatusToStr(const SensorStatus status) {
+  switch (status) {
+    case S_OK:              return "ok";
+    case S_NO_PRESENCE:     return "keine Antwort";
+    case S_CRC_ERROR:       return "Prüfsummenfehler";
+    case S_BUS_ERROR:       return "Busfehler";
+    case S_POWER_ON_VALUE:  return "Einschaltwert";
+    case S_INVALID_VALUE:   return "nicht berechenbar";
+    default:                return "unbekannt";
+  }
+}
 
-  // Verwende strtol, um den hexadezimalen C-String in eine Ganzzahl (long) zu konvertieren
-  long value = strtol(tempString, nullptr, 16);
-  
-  // Konvertiere die Ganzzahl auf einen byte-Wert (0-255)
-  byte result = static_cast<byte>(value);
+const char* sensorHealthToStr(const SensorHealth health) {
+  switch (health) {
+    case H_OK:              return "ok";
+    case H_DEGRADED:        return "gestört";
+    case H_QUARANTINED:     return "Quarantäne";
+    default:                return "unbekannt";
+  }
+}
 
-  return result;
+int hexDigitValue(const char c) {
+  // -1, wenn c keine Hex-Ziffer ist
+  if (c < '0' || c > 'f') {
+    return -1;
+  }
+  return hexDecodeTable[c - '0'];
 }
 
 void copyDeviceAddress(const DeviceAddress in, DeviceAddress out) {
@@ -185,32 +827,52 @@ void copyDeviceAddress(const DeviceAddress in, DeviceAddress out) {
   }
 }
 
-bool strToDeviceAddress(const String &str, DeviceAddress &addr) {
-  // Überprüfen, ob die Zeichenkette die richtige Länge hat
-  if (str.length() != 16) {
-    return false; // Fehler, wenn die Länge nicht korrekt ist
+void deviceAddressToHex(const DeviceAddress addr, SensorAddress out) {
+  // Jedes Byte wird zu genau zwei Zeichen, so ist die Umwandlung umkehrbar
+  for (uint8_t j = 0; j < 8; j++) {
+    out[j * 2]     = hexEncodeTable[addr[j] >> 4];
+    out[j * 2 + 1] = hexEncodeTable[addr[j] & 0x0F];
   }
+  out[16] = '\0';
+}
+
+bool hexToDeviceAddress(const char* hex, DeviceAddress addr) {
+  int high;
+  int low;
 
   for (uint8_t j = 0; j < 8; j++) {
-    // Extrahiere zwei Zeichen von der Zeichenkette
-    String hexStr = str.substring(j * 2, j * 2 + 2);
-    
-    // Konvertiere die extrahierten Zeichen in einen Hexadezimalwert
-    addr[j] = strtol(hexStr.c_str(), nullptr, 16);
+    // Ein zu kurzer String endet mit '\0' und scheitert hier, vor dem Lesen hinter seinem Ende
+    high = hexDigitValue(hex[j * 2]);
+    low  = high < 0 ? -1 : hexDigitValue(hex[j * 2 + 1]);
+    if (low < 0) {
+      return false;
+    }
+    addr[j] = (high << 4) | low;
   }
-
-  return true; // Konvertierung erfolgreich
+  return hex[16] == '\0';
 }
 
+SensorRom deviceAddressToRom(const DeviceAddress addr) {
+  // Das erste Byte (Familien-Code) wird zum höchsten, so entspricht die Sortierung der des Hex-Strings
+  SensorRom rom = 0;
+  for (uint8_t j = 0; j < 8; j++) {
+    rom = (rom << 8) | addr[j];
+  }
+  return rom;
+}
 
-bool getSensorTypeByAddress(const SensorAddress manufacturerCode, SensorType &sensorType) {
-  char code[17];
-  byte firstByte;
-  // Überprüfe nur das erste Byte des char-Arrays
-  strcpy(code, manufacturerCode);
-  firstByte = convertHexCStringToByte(code);
+bool isConfigAddressOf(const DeviceAddress configAddr, const DeviceAddress addr) {
+  // Ältere Versionen haben Bytes unter 0x10 als "00" ausgegeben. So erfasste Adressen in der Konfig passen weiterhin.
+  for (uint8_t j = 0; j < 8; j++) {
+    if (configAddr[j] != addr[j] && !(addr[j] < 0x10 && configAddr[j] == 0)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  switch (firstByte) {
+bool getSensorTypeByFamily(const uint8_t family, SensorType &sensorType) {
+  switch (family) {
     case 0x28:
       sensorType = T_DS18B20; // DS18B20 Temperatursensor
       return true;
@@ -229,40 +891,164 @@ bool getSensorTypeByAddress(const SensorAddress manufacturerCode, SensorType &se
     }
 }
 
+boolean hasAlarmBand(const SensorConfig &config) {
+  // Ein Band ist nur gültig, wenn TL unter TH liegt und mindestens eine Schwelle innerhalb des Messbereichs liegt
+  return config.alarmLow < config.alarmHigh && (config.alarmLow > sensorAlarmLowOff || config.alarmHigh < sensorAlarmHighOff);
+}
 
-String deviceAddressToStr(DeviceAddress addr) {
-  String returnString = "";
-    for (uint8_t j = 0; j < 8; j++) {
-      // if (addr[j] < 16) returnString = "0";  // War im ursprünglichen Vorschlag einer Konvertierung, scheint aber keinen Sinn zu machen, da HEX 00 legitim ist.
-      if (addr[j] < 16) {
-        returnString = returnString + "00";
-      } else {
-      returnString = returnString + String(addr[j], HEX);
-      }
+SensorAlarm strToAlarm(const char* input, const SensorAlarm off) {
+  // Ein leeres Feld schaltet die Schwelle ab, sonst ganze °C im Messbereich des DS18B20
+  if (input == nullptr || input[0] == '\0') {
+    return off;
+  }
+  return constrain(atoi(input), sensorAlarmLowOff, sensorAlarmHighOff);
+}
+
+int internFormat(char *pool, const int poolSize, const char *format) {
+  // Liefert den Index des Format-Strings in pool und hängt ihn an, falls er noch fehlt. -1, wenn pool voll ist.
+  int pos   = 0;
+  int index = 0;
+  int length = strlen(format);
+
+  while (pos < poolSize && pool[pos] != '\0') {
+    if (strcmp(&pool[pos], format) == 0) {
+      return index;
     }
-  returnString.toUpperCase();
-  return returnString;
+    pos += strlen(&pool[pos]) + 1;
+    index++;
+  }
+  // Hinter dem letzten String muss ein '\0' als Ende der Liste bleiben
+  if (pos + length + 2 > poolSize) {
+    return -1;
+  }
+  strcpy(&pool[pos], format);
+  pool[pos + length + 1] = '\0';
+  return index;
 }
 
-void deviceAddressToStrNew(const DeviceAddress addr, String out) {
-  out = "";
-    for (uint8_t j = 0; j < 8; j++) {
-      if (addr[j] < 16) out = "0";
-      out = out + String(addr[j], HEX);
-      Serial.println("deviceAddrToStrNew() Durchlauf " + String(j) + ": out = " + out);
+const char* getInternedFormat(const char *pool, const int poolSize, const int index) {
+  int pos = 0;
+
+  for (int i = 0; pos < poolSize && pool[pos] != '\0'; i++) {
+    if (i == index) {
+      return &pool[pos];
     }
-  out.toUpperCase();
-  Serial.println("deviceAddrToStrNew() ende, out = " + out);
+    pos += strlen(&pool[pos]) + 1;
+  }
+  return nullptr;
 }
 
-const char* deviceAddressToChar(DeviceAddress addr) {
-  static SensorAddress result;
-  String returnString = "";
-    for (uint8_t j = 0; j < 8; j++) {
-      if (addr[j] < 16) returnString = "0";
-      returnString = returnString + String(addr[j], HEX);
+int encodeSensorRecord(const DeviceAddress addr, const SensorConfig &config, const int formatIndex, uint8_t *out, const int space) {
+  // Schreibt den Eintrag nach out und liefert seine Länge, 0 wenn space nicht reicht. formatIndex < 0 = Standard-Format.
+  SensorConfig  defaults;
+  uint8_t       record[8 + 1 + 1 + sizeof(SensorName) + 1 + 4 * sizeof(float) + 5];
+  uint8_t       mask    = 0;
+  int           length  = 9;
+  uint8_t       nameLength;
+
+  if (config.name[0] != '\0') {
+    mask |= SR_NAME;
+    nameLength = strlen(config.name);
+    record[length++] = nameLength;
+    memcpy(&record[length], config.name, nameLength);
+    length += nameLength;
+  }
+  if (formatIndex >= 0) {
+    mask |= SR_FORMAT;
+    record[length++] = formatIndex;
+  }
+  if (config.formatMin != defaults.formatMin || config.formatMax != defaults.formatMax) {
+    mask |= SR_FORMAT_RANGE;
+    memcpy(&record[length], &config.formatMin, 4);
+    memcpy(&record[length + 4], &config.formatMax, 4);
+    length += 8;
+  }
+  if (config.min != defaults.min || config.max != defaults.max) {
+    mask |= SR_VALUE_RANGE;
+    memcpy(&record[length], &config.min, 4);
+    memcpy(&record[length + 4], &config.max, 4);
+    length += 8;
+  }
+  if (config.precision != defaults.precision) {
+    mask |= SR_PRECISION;
+    record[length++] = config.precision;
+  }
+  if (config.channels != defaults.channels) {
+    mask |= SR_CHANNELS;
+    record[length++] = config.channels;
+  }
+  if (config.resolution != defaults.resolution) {
+    mask |= SR_RESOLUTION;
+    record[length++] = config.resolution;
+  }
+  if (config.alarmLow != defaults.alarmLow || config.alarmHigh != defaults.alarmHigh) {
+    mask |= SR_ALARM;
+    record[length++] = config.alarmLow;
+    record[length++] = config.alarmHigh;
+  }
+  memcpy(record, addr, 8);
+  record[8] = mask;
+
+  if (length > space) {
+    return 0;
+  }
+  memcpy(out, record, length);
+  return length;
+}
+
+int decodeSensorRecord(const uint8_t *in, const int length, DeviceAddress addr, SensorConfig &config, int &formatIndex) {
+  // Liest einen Eintrag ab in und liefert seine Länge, 0 wenn er über length hinausreicht (beschädigte Konfig)
+  int     pos = 9;
+  uint8_t mask;
+  uint8_t nameLength;
+
+  if (length < 9) {
+    return 0;
+  }
+  config      = SensorConfig();
+  formatIndex = -1;
+  memcpy(addr, in, 8);
+  mask = in[8];
+
+  if (mask & SR_NAME) {
+    if (pos >= length || in[pos] >= sizeof(SensorName) || pos + 1 + in[pos] > length) {
+      return 0;
     }
-  returnString.toUpperCase();
-  strcpy(result, returnString.c_str());
-  return result;
+    nameLength = in[pos++];
+    memcpy(config.name, &in[pos], nameLength);
+    config.name[nameLength] = '\0';
+    pos += nameLength;
+  }
+  // Alle übrigen Felder haben eine feste Länge, prüfe sie gemeinsam
+  if (pos + ((mask & SR_FORMAT) ? 1 : 0) + ((mask & SR_FORMAT_RANGE) ? 8 : 0) + ((mask & SR_VALUE_RANGE) ? 8 : 0) +
+      ((mask & SR_PRECISION) ? 1 : 0) + ((mask & SR_CHANNELS) ? 1 : 0) + ((mask & SR_RESOLUTION) ? 1 : 0) + ((mask & SR_ALARM) ? 2 : 0) > length) {
+    return 0;
+  }
+  if (mask & SR_FORMAT) {
+    formatIndex = in[pos++];
+  }
+  if (mask & SR_FORMAT_RANGE) {
+    memcpy(&config.formatMin, &in[pos], 4);
+    memcpy(&config.formatMax, &in[pos + 4], 4);
+    pos += 8;
+  }
+  if (mask & SR_VALUE_RANGE) {
+    memcpy(&config.min, &in[pos], 4);
+    memcpy(&config.max, &in[pos + 4], 4);
+    pos += 8;
+  }
+  if (mask & SR_PRECISION) {
+    config.precision = (int8_t)in[pos++];
+  }
+  if (mask & SR_CHANNELS) {
+    config.channels = in[pos++];
+  }
+  if (mask & SR_RESOLUTION) {
+    config.resolution = in[pos++];
+  }
+  if (mask & SR_ALARM) {
+    config.alarmLow   = (SensorAlarm)in[pos++];
+    config.alarmHigh  = (SensorAlarm)in[pos++];
+  }
+  return pos;
 }
@@ -0,0 +1,365 @@
+#include <Arduino.h>
+
+/*
+    Abgeleitete (virtuelle) Sensoren, wird nach sensors.h eingebunden.
+
+    Ein abgeleiteter Sensor berechnet seinen Wert per Ausdruck aus den Werten anderer Sensoren, z.B. die relative
+    Feuchte aus Kanal A und B eines DS2438 (siehe lib/DS2438/examples/DS2438Humidity):
+
+    ({Feuchte.A} / {Feuchte.B} - 0.16) / 0.0062
+
+    Erlaubt sind Zahlen, + - * /, Vorzeichen, Klammern und Verweise auf Sensoren in geschweiften Klammern, per Name
+    aus der Konfig oder per Adresse. Ein angehängtes .A, .B oder .T liest bei einem DS2438 gezielt Kanal A, Kanal B
+    oder die Temperatur, ohne Anhang gilt der Wert des Sensors. Werte gehen in °C bzw. V in die Rechnung ein.
+
+    Der Ausdruck wird einmalig per compileVirtualExpression() in einen kompakten Stack-Bytecode übersetzt, die
+    Verweise werden dabei zu ROM-Codes aufgelöst. evaluateVirtualProgram() rechnet nur noch mit Festkommazahlen
+    (16 Nachkommabits), ohne den Ausdruck erneut zu lesen.
+*/
+
+const int virtualCodeSize   = 48;   // Bytes Bytecode je Ausdruck
+const int virtualInputCount = 4;    // Gibt an, auf wie viele Sensoren ein Ausdruck verweisen kann
+const int virtualStackSize  = 8;    // Tiefe des Rechen-Stacks, wird beim Übersetzen geprüft
+
+typedef int64_t VirtualValue;       // Festkommazahl mit 16 Nachkommabits
+
+// Größter Betrag eines Zwischenergebnisses (ca. 2^31), darüber bricht evaluateVirtualProgram() mit Überlauf ab.
+// So passen a * b vor dem Schieben und a * 65536 bei der Division sicher in int64.
+const VirtualValue virtualValueMax = (VirtualValue)INT32_MAX << 16;
+
+typedef enum {
+  V_CONST           = 0,  // Konstante, es folgen 4 Bytes (int32_t, 16 Nachkommabits)
+  V_INPUT           = 1,  // Wert eines Verweises, es folgt 1 Byte Index in inputs
+  V_ADD             = 2,
+  V_SUB             = 3,
+  V_MUL             = 4,
+  V_DIV             = 5,
+  V_NEG             = 6
+} VirtualOp;
+
+typedef enum {
+  VC_VALUE          = 0,  // Wert des Sensors
+  VC_CHANNEL_A      = 1,  // Nur DS2438: Spannung Kanal A
+  VC_CHANNEL_B      = 2,  // Nur DS2438: Spannung Kanal B
+  VC_TEMPERATURE    = 3   // Nur DS2438: Temperatur
+} VirtualChannel;
+
+struct VirtualInput {
+  SensorRom             rom             = 0;          // Sensor, auf den verwiesen wird
+  VirtualChannel        channel         = VC_VALUE;
+  SensorRaw             last            = 0;          // Wert bei der letzten Berechnung, zur Erkennung von Änderungen
+  boolean               valid           = false;      // last ist gültig
+};
+
+struct VirtualProgram {
+  uint8_t               code[virtualCodeSize];
+  uint8_t               length          = 0;          // Länge des Bytecodes
+  VirtualInput          inputs[virtualInputCount];
+  uint8_t               inputCount      = 0;
+  int                   sensor          = -1;         // Index des abgeleiteten Sensors in sensors.sensorList
+};
+
+// Löst einen Namen aus der Konfig in einen ROM-Code auf, wird von main.cpp bereitgestellt
+typedef boolean (*VirtualResolver)(const char *name, DeviceAddress deviceAddress);
+
+struct VirtualParser {
+  const char*           pos;
+  VirtualProgram*       program;
+  VirtualResolver       resolve;
+  int                   depth;                        // Aktuelle Tiefe des Stacks beim Ausführen
+  double                constant;                     // Wert der zuletzt übersetzten Zahl
+  boolean               error;
+};
+
+// *************** Deklaration der Funktionen
+boolean compileVirtualExpression(const char *expression, VirtualProgram &program, VirtualResolver resolve);
+boolean evaluateVirtualProgram(const VirtualProgram &program, const VirtualValue *inputs, VirtualValue &result);
+boolean virtualFitsConstant(const double number);
+boolean virtualMultiply(const VirtualValue a, const VirtualValue b, VirtualValue &result);
+void virtualParseExpression(VirtualParser &parser);
+
+// ***************  Funktionen
+void virtualFail(VirtualParser &parser, const char *message) {
+  if (!parser.error) {
+    Serial.print("compileVirtualExpression(): ");
+    Serial.print(message);
+    Serial.print(" bei \"");
+    Serial.print(parser.pos);
+    Serial.println("\"");
+  }
+  parser.error = true;
+}
+
+void virtualSkipSpaces(VirtualParser &parser) {
+  while (*parser.pos == ' ') {
+    parser.pos++;
+  }
+}
+
+void virtualEmit(VirtualParser &parser, const uint8_t byte) {
+  if (parser.program->length >= virtualCodeSize) {
+    virtualFail(parser, "Ausdruck zu lang, virtualCodeSize erhöhen");
+    return;
+  }
+  parser.program->code[parser.program->length++] = byte;
+}
+
+void virtualPush(VirtualParser &parser) {
+  if (++parser.depth > virtualStackSize) {
+    virtualFail(parser, "Ausdruck zu tief verschachtelt, virtualStackSize erhöhen");
+  }
+}
+
+void virtualParseReference(VirtualParser &parser) {
+  // {Name}, {Name.A}, {Adresse.T} usw., die öffnende Klammer ist schon gelesen
+  char            name[sizeof(SensorName) + 2];
+  int             length  = 0;
+  VirtualChannel  channel = VC_VALUE;
+  DeviceAddress   deviceAddress;
+  SensorRom       rom;
+  int             input;
+
+  while (*parser.pos != '}' && *parser.pos != '\0') {
+    if (length >= (int)sizeof(name) - 1) {
+      virtualFail(parser, "Name zu lang");
+      return;
+    }
+    name[length++] = *parser.pos++;
+  }
+  if (*parser.pos != '}') {
+    virtualFail(parser, "} fehlt");
+    return;
+  }
+  parser.pos++;
+  name[length] = '\0';
+
+  // Ein Anhang .A, .B oder .T wählt den Kanal eines DS2438
+  if (length > 2 && name[length - 2] == '.') {
+    switch (name[length - 1]) {
+      case 'A': channel = VC_CHANNEL_A;   break;
+      case 'B': channel = VC_CHANNEL_B;   break;
+      case 'T': channel = VC_TEMPERATURE; break;
+    }
+    if (channel != VC_VALUE) {
+      name[length - 2] = '\0';
+    }
+  }
+  if (!hexToDeviceAddress(name, deviceAddress) && !parser.resolve(name, deviceAddress)) {
+    virtualFail(parser, "Unbekannter Sensor");
+    return;
+  }
+  rom = deviceAddressToRom(deviceAddress);
+
+  // Mehrfache Verweise auf denselben Wert teilen sich einen Eintrag
+  VirtualProgram &program = *parser.program;
+  for (input = 0; input < program.inputCount; input++) {
+    if (program.inputs[input].rom == rom && program.inputs[input].channel == channel) {
+      break;
+    }
+  }
+  if (input == program.inputCount) {
+    if (program.inputCount >= virtualInputCount) {
+      virtualFail(parser, "Zu viele Sensoren, virtualInputCount erhöhen");
+      return;
+    }
+    program.inputs[input]         = VirtualInput();
+    program.inputs[input].rom     = rom;
+    program.inputs[input].channel = channel;
+    program.inputCount++;
+  }
+  virtualEmit(parser, V_INPUT);
+  virtualEmit(parser, input);
+  virtualPush(parser);
+}
+
+boolean virtualFitsConstant(const double number) {
+  // V_CONST speichert die Zahl als int32_t mit 16 Nachkommabits
+  int64_t fixed = toFixed16(number);
+
+  return fixed <= INT32_MAX && fixed >= INT32_MIN;
+}
+
+void virtualEmitConstant(VirtualParser &parser, const double number) {
+  int32_t constant;
+
+  if (!virtualFitsConstant(number)) {
+    virtualFail(parser, "Zahl zu groß");
+    return;
+  }
+  constant = toFixed16(number);
+  virtualEmit(parser, V_CONST);
+  for (int i = 0; i < 4; i++) {
+    virtualEmit(parser, (constant >> (8 * i)) & 0xFF);
+  }
+}
+
+void virtualParsePrimary(VirtualParser &parser) {
+  char*   end;
+  double  number;
+
+  virtualSkipSpaces(parser);
+  if (*parser.pos == '(') {
+    parser.pos++;
+    virtualParseExpression(parser);
+    virtualSkipSpaces(parser);
+    if (*parser.pos != ')') {
+      virtualFail(parser, ") fehlt");
+      return;
+    }
+    parser.pos++;
+  } else if (*parser.pos == '{') {
+    parser.pos++;
+    virtualParseReference(parser);
+  } else if (*parser.pos == '-') {
+    parser.pos++;
+    virtualParsePrimary(parser);
+    virtualEmit(parser, V_NEG);
+  } else {
+    number = strtod(parser.pos, &end);
+    if (end == parser.pos) {
+      virtualFail(parser, "Zahl, Verweis oder ( erwartet");
+      return;
+    }
+    parser.pos      = end;
+    parser.constant = number;
+    virtualEmitConstant(parser, number);
+    virtualPush(parser);
+  }
+}
+
+void virtualParseTerm(VirtualParser &parser) {
+  char  op;
+  int   start;
+  int   exponent;
+
+  virtualParsePrimary(parser);
+  virtualSkipSpaces(parser);
+  while (!parser.error && (*parser.pos == '*' || *parser.pos == '/')) {
+    op    = *parser.pos++;
+    start = parser.program->length;
+    virtualParsePrimary(parser);
+    // Geteilt durch eine Zahl wird zum Mal mit dem Kehrwert, aber nur, wenn dieser mit 16 Nachkommabits mindestens so 
+    // genau ist wie die Zahl selbst: bei |Zahl| <= 1 (z.B. 0.0062) und bei Zweierpotenzen bis 65536. Bei anderen 
+    // großen Teilern wie 1000 wäre der Kehrwert grob gerundet oder 0, dort bleibt es bei der Division zur Laufzeit.
+    // Ebenso bei sehr kleinen Teilern, deren Kehrwert nicht mehr in V_CONST passt.
+    if (!parser.error && op == '/' && parser.program->length == start + 5 && parser.program->code[start] == V_CONST && parser.constant != 0 &&
+        (fabs(parser.constant) <= 1 || (frexp(fabs(parser.constant), &exponent) == 0.5 && exponent <= 17)) &&
+        virtualFitsConstant(1.0 / parser.constant)) {
+      parser.program->length = start;
+      virtualEmitConstant(parser, 1.0 / parser.constant);
+      op = '*';
+    }
+    virtualEmit(parser, op == '*' ? V_MUL : V_DIV);
+    parser.depth--;
+    virtualSkipSpaces(parser);
+  }
+}
+
+void virtualParseExpression(VirtualParser &parser) {
+  char op;
+
+  virtualParseTerm(parser);
+  virtualSkipSpaces(parser);
+  while (!parser.error && (*parser.pos == '+' || *parser.pos == '-')) {
+    op = *parser.pos++;
+    virtualParseTerm(parser);
+    virtualEmit(parser, op == '+' ? V_ADD : V_SUB);
+    parser.depth--;
+    virtualSkipSpaces(parser);
+  }
+}
+
+boolean compileVirtualExpression(const char *expression, VirtualProgram &program, VirtualResolver resolve) {
+  // Übersetzt den Ausdruck in program, false bei einem Fehler (wird seriell ausgegeben)
+  VirtualParser parser;
+
+  program.length      = 0;
+  program.inputCount  = 0;
+  parser.pos          = expression;
+  parser.program      = &program;
+  parser.resolve      = resolve;
+  parser.depth        = 0;
+  parser.error        = false;
+
+  virtualParseExpression(parser);
+  virtualSkipSpaces(parser);
+  if (!parser.error && *parser.pos != '\0') {
+    virtualFail(parser, "Unerwartetes Zeichen");
+  }
+  if (parser.error) {
+    program.length = 0;
+    return false;
+  }
+  return true;
+}
+
+boolean virtualMultiply(const VirtualValue a, const VirtualValue b, VirtualValue &result) {
+  // a * b mit 16 Nachkommabits, false bei Überlauf über virtualValueMax. Die Division zur Prüfung ist nur nötig, 
+  // wenn ein Faktor größer als 32768 ist.
+  VirtualValue absA = a < 0 ? -a : a;
+  VirtualValue absB = b < 0 ? -b : b;
+
+  if ((absA > INT32_MAX || absB > INT32_MAX) && absB != 0 && absA > (virtualValueMax << 16) / absB) {
+    return false;
+  }
+  result = (a * b) >> 16;
+  return true;
+}
+
+boolean evaluateVirtualProgram(const VirtualProgram &program, const VirtualValue *inputs, VirtualValue &result) {
+  /*
+    Führt den Bytecode aus, inputs enthält die Werte der Verweise. false bei Division durch 0 und bei Überlauf: 
+    Jedes Zwischenergebnis muss im Betrag unter virtualValueMax bleiben, sonst wäre der Wert ohne Warnung falsch.
+  */
+  VirtualValue  stack[virtualStackSize];
+  int           top = 0;
+  int           pc  = 0;
+  int32_t       constant;
+
+  while (pc < program.length) {
+    switch (program.code[pc++]) {
+      case V_CONST:
+        constant = (int32_t)((uint32_t)program.code[pc] | ((uint32_t)program.code[pc + 1] << 8) | ((uint32_t)program.code[pc + 2] << 16) | ((uint32_t)program.code[pc + 3] << 24));
+        pc += 4;
+        stack[top++] = constant;
+        break;
+      case V_INPUT:
+        stack[top++] = inputs[program.code[pc++]];
+        break;
+      case V_ADD:
+        top--;
+        stack[top - 1] += stack[top];
+        break;
+      case V_SUB:
+        top--;
+        stack[top - 1] -= stack[top];
+        break;
+      case V_MUL:
+        top--;
+        if (!virtualMultiply(stack[top - 1], stack[top], stack[top - 1])) {
+          return false;
+        }
+        break;
+      case V_DIV:
+        top--;
+        if (stack[top] == 0) {
+          return false;
+        }
+        stack[top - 1] = (stack[top - 1] * 65536) / stack[top];
+        break;
+      case V_NEG:
+        stack[top - 1] = -stack[top - 1];
+        break;
+      default:
+        return false;
+    }
+    if (stack[top - 1] > virtualValueMax || stack[top - 1] < -virtualValueMax) {
+      return false;
+    }
+  }
+  if (top != 1) {
+    return false;
+  }
+  result = stack[0];
+  return true;
+}